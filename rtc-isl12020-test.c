@@ -0,0 +1,878 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * rtc-isl12020 - Renesas ISL12020M RTC I2C driver kunit tests
+ * Copyright (C) 2023 Wilken Gottwalt <wilken.gottwalt@posteo.net>
+ */
+
+#include <kunit/device.h>
+#include <kunit/test.h>
+#include <linux/bcd.h>
+#include <linux/bitfield.h>
+#include <linux/device.h>
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/property.h>
+#include <linux/regmap.h>
+#include <linux/rtc.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+
+#include "rtc-isl12020.h"
+
+/* 2023-06-15 12:34:56, a thursday */
+#define TEST_TIME		1686832496LL
+/* 2024-02-29 23:59:58, a thursday, one second before the hour rolls over */
+#define TEST_LEAP_TIME		1709251198LL
+
+#define TEST_ADDR		0x6f
+#define TEST_TEMP_RAW		596 /* 25 degree celcius */
+
+#define TEST_FUNC_I2C		(I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL)
+#define TEST_FUNC_BLOCK		(I2C_FUNC_SMBUS_I2C_BLOCK | I2C_FUNC_SMBUS_BYTE_DATA)
+#define TEST_FUNC_BYTE		I2C_FUNC_SMBUS_BYTE_DATA
+
+/*
+ * model of the chip behind a fake adapter, the time only counts and the time registers only
+ * take writes with WRTC set, a write to the time registers clears RTCF, SR bits can only be
+ * cleared and the read only registers ignore writes, every transfer carrying data is counted
+ */
+struct isl12020_test_chip {
+	struct i2c_adapter adap;
+	u32 func;
+	u8 regs[256];
+	u8 ptr;				/* register address pointer of plain i2c transfers */
+	unsigned int reads;
+	unsigned int writes;
+	unsigned int ignored;		/* register writes dropped by the chip */
+	unsigned int tick_after;	/* count one second after this many reads, 0 = never */
+};
+
+struct isl12020_test_ctx {
+	struct isl12020_test_chip chip;
+	struct i2c_client *client;
+	struct isl12020_data *priv;
+};
+
+static void isl12020_test_chip_set_time(struct isl12020_test_chip *chip, time64_t secs)
+{
+	struct rtc_time tm;
+
+	rtc_time64_to_tm(secs, &tm);
+	chip->regs[ISL_REG_RTC_SC] = bin2bcd(tm.tm_sec);
+	chip->regs[ISL_REG_RTC_MN] = bin2bcd(tm.tm_min);
+	chip->regs[ISL_REG_RTC_HR] = bin2bcd(tm.tm_hour) | ISL_BIT_RTC_HR_MIL;
+	chip->regs[ISL_REG_RTC_DT] = bin2bcd(tm.tm_mday);
+	chip->regs[ISL_REG_RTC_MO] = bin2bcd(tm.tm_mon + 1);
+	chip->regs[ISL_REG_RTC_YR] = bin2bcd(tm.tm_year % 100);
+	chip->regs[ISL_REG_RTC_DW] = tm.tm_wday;
+}
+
+static void isl12020_test_chip_tick(struct isl12020_test_chip *chip)
+{
+	const u8 *regs = chip->regs;
+	time64_t secs;
+
+	if (!(regs[ISL_REG_CSR_INT] & ISL_BIT_CSR_INT_WRTC))
+		return;
+
+	secs = mktime64(2000 + bcd2bin(regs[ISL_REG_RTC_YR]), bcd2bin(regs[ISL_REG_RTC_MO]),
+			bcd2bin(regs[ISL_REG_RTC_DT]), bcd2bin(regs[ISL_REG_RTC_HR] & MASK6BITS),
+			bcd2bin(regs[ISL_REG_RTC_MN]), bcd2bin(regs[ISL_REG_RTC_SC]));
+	isl12020_test_chip_set_time(chip, secs + 1);
+}
+
+static void isl12020_test_chip_read(struct isl12020_test_chip *chip, u8 reg, u8 *buf,
+				    size_t len)
+{
+	while (len--)
+		*buf++ = chip->regs[reg++];
+
+	chip->reads++;
+	if (chip->tick_after && !--chip->tick_after)
+		isl12020_test_chip_tick(chip);
+}
+
+static void isl12020_test_chip_write(struct isl12020_test_chip *chip, u8 reg, const u8 *buf,
+				     size_t len)
+{
+	for (; len; len--, reg++, buf++) {
+		switch (reg) {
+		case ISL_REG_RTC_SC ... ISL_REG_RTC_DW:
+			if (!(chip->regs[ISL_REG_CSR_INT] & ISL_BIT_CSR_INT_WRTC)) {
+				chip->ignored++;
+				break;
+			}
+			chip->regs[reg] = *buf;
+			chip->regs[ISL_REG_CSR_SR] &= ~ISL_BIT_CSR_SR_RTCF;
+			break;
+		case ISL_REG_CSR_SR:
+			chip->regs[reg] &= *buf;
+			break;
+		case ISL_REG_CSR_FATR:
+		case ISL_REG_CSR_FDTR:
+		case ISL_REG_TSV2B_VSC ... ISL_REG_TSB2V_BMO:
+		case ISL_REG_TEMP_TKOL:
+		case ISL_REG_TEMP_TKOM:
+			chip->ignored++;
+			break;
+		default:
+			chip->regs[reg] = *buf;
+			break;
+		}
+	}
+
+	chip->writes++;
+}
+
+static int isl12020_test_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	struct isl12020_test_chip *chip = i2c_get_adapdata(adap);
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (msgs[i].flags & I2C_M_RD) {
+			isl12020_test_chip_read(chip, chip->ptr, msgs[i].buf, msgs[i].len);
+			chip->ptr += msgs[i].len;
+		} else if (msgs[i].len) {
+			chip->ptr = msgs[i].buf[0];
+			if (msgs[i].len > 1) {
+				isl12020_test_chip_write(chip, chip->ptr, &msgs[i].buf[1],
+							 msgs[i].len - 1);
+				chip->ptr += msgs[i].len - 1;
+			}
+		}
+	}
+
+	return num;
+}
+
+static int isl12020_test_smbus_xfer(struct i2c_adapter *adap, u16 addr, unsigned short flags,
+				    char read_write, u8 command, int size,
+				    union i2c_smbus_data *data)
+{
+	struct isl12020_test_chip *chip = i2c_get_adapdata(adap);
+
+	switch (size) {
+	case I2C_SMBUS_BYTE_DATA:
+		if (read_write == I2C_SMBUS_READ)
+			isl12020_test_chip_read(chip, command, &data->byte, 1);
+		else
+			isl12020_test_chip_write(chip, command, &data->byte, 1);
+		return 0;
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		if (read_write == I2C_SMBUS_READ)
+			isl12020_test_chip_read(chip, command, &data->block[1], data->block[0]);
+		else
+			isl12020_test_chip_write(chip, command, &data->block[1], data->block[0]);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static u32 isl12020_test_functionality(struct i2c_adapter *adap)
+{
+	struct isl12020_test_chip *chip = i2c_get_adapdata(adap);
+
+	return chip->func;
+}
+
+static const struct i2c_algorithm isl12020_test_algo = {
+	.master_xfer = isl12020_test_xfer,
+	.smbus_xfer = isl12020_test_smbus_xfer,
+	.functionality = isl12020_test_functionality,
+};
+
+/* the i2c core enforces these on plain i2c transfers */
+static const struct i2c_adapter_quirks isl12020_test_quirks = {
+	.max_read_len = 8,
+	.max_write_len = 16,
+};
+
+static const struct property_entry isl12020_test_props[] = {
+	PROPERTY_ENTRY_BOOL("temperature-sensor-enable"),
+	PROPERTY_ENTRY_BOOL("battery-temperature-sensor-enable"),
+	PROPERTY_ENTRY_U32("frequency-output-mode", 1),
+	PROPERTY_ENTRY_U32("time-cache-interval", 5),
+	{ }
+};
+
+static const struct software_node isl12020_test_node = {
+	.properties = isl12020_test_props,
+};
+
+static void isl12020_test_del_adapter(void *data)
+{
+	i2c_del_adapter(data);
+}
+
+/* the adapter is there for every case, the chip state may be changed until the probe */
+static int isl12020_test_init(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx;
+	struct isl12020_test_chip *chip;
+	struct device *dev;
+	int err;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx);
+
+	dev = kunit_device_register(test, "rtc-isl12020-test");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+
+	chip = &ctx->chip;
+	chip->func = TEST_FUNC_I2C;
+	isl12020_test_chip_set_time(chip, TEST_TIME);
+	chip->regs[ISL_REG_CSR_INT] = ISL_BIT_CSR_INT_WRTC | ISL_BIT_CSR_INT_FOBATB;
+	chip->regs[ISL_REG_CSR_ITRO] = TRIM_IATR_NOMINAL;
+	chip->regs[ISL_REG_TEMP_TKOL] = TEST_TEMP_RAW & 0xff;
+	chip->regs[ISL_REG_TEMP_TKOM] = TEST_TEMP_RAW >> 8;
+
+	chip->adap.owner = THIS_MODULE;
+	chip->adap.algo = &isl12020_test_algo;
+	chip->adap.dev.parent = dev;
+	strscpy(chip->adap.name, "rtc-isl12020-test", sizeof(chip->adap.name));
+	i2c_set_adapdata(&chip->adap, chip);
+
+	err = i2c_add_adapter(&chip->adap);
+	KUNIT_ASSERT_EQ(test, err, 0);
+
+	/* takes the client and with it the driver instance along */
+	err = kunit_add_action_or_reset(test, isl12020_test_del_adapter, &chip->adap);
+	KUNIT_ASSERT_EQ(test, err, 0);
+
+	test->priv = ctx;
+
+	return 0;
+}
+
+/* bind the driver to a new client, the transfer counters only count what follows */
+static struct isl12020_data *isl12020_test_probe(struct kunit *test,
+						 const struct software_node *swnode)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct i2c_board_info info = {
+		I2C_BOARD_INFO("isl12020irz", TEST_ADDR),
+		.swnode = swnode,
+	};
+
+	ctx->client = i2c_new_client_device(&ctx->chip.adap, &info);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->client);
+
+	/* the driver prefers asynchronous probing, the setup work follows the probe */
+	wait_for_device_probe();
+	KUNIT_ASSERT_NOT_NULL(test, ctx->client->dev.driver);
+	ctx->priv = i2c_get_clientdata(ctx->client);
+	flush_work(&ctx->priv->setup_work);
+
+	ctx->chip.reads = 0;
+	ctx->chip.writes = 0;
+	ctx->chip.ignored = 0;
+
+	return ctx->priv;
+}
+
+/* the time cache logic does not touch the bus */
+static struct isl12020_data *isl12020_test_cache_priv(struct kunit *test)
+{
+	struct isl12020_data *priv;
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+	spin_lock_init(&priv->time_cache.lock);
+
+	return priv;
+}
+
+static ssize_t isl12020_test_attr(struct kunit *test, const char *name, const char *store,
+				  char *show)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	const struct attribute **attr;
+	struct device_attribute *dattr;
+
+	for (attr = isl12020_attrs; *attr; attr++)
+		if (!strcmp((*attr)->name, name))
+			break;
+	KUNIT_ASSERT_NOT_NULL_MSG(test, *attr, "no attribute %s", name);
+	dattr = container_of(*attr, struct device_attribute, attr);
+
+	if (store)
+		return dattr->store(&ctx->client->dev, dattr, store, strlen(store));
+
+	return dattr->show(&ctx->client->dev, dattr, show);
+}
+
+static void isl12020_test_trim_to_offset(struct kunit *test)
+{
+	const u8 idtr_plus = FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, 1);
+	const u8 idtr_none = FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, 2);
+	const u8 idtr_minus = FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, 3);
+
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(TRIM_IATR_NOMINAL), 0);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(0), 32000);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(ISL_MASK_CSR_ITRO_IATR), -31000);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(TRIM_IATR_NOMINAL + 5), -5000);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(idtr_plus | TRIM_IATR_NOMINAL), 30500);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(idtr_minus | TRIM_IATR_NOMINAL), -30500);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(idtr_none | TRIM_IATR_NOMINAL), 0);
+	KUNIT_EXPECT_EQ(test, isl12020_trim_to_offset(idtr_plus), 62500);
+}
+
+static void isl12020_test_set_trim(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_probe(test, NULL);
+	struct isl12020_test_ctx *ctx = test->priv;
+	static const long offsets[] = { 0, 5000, -12000, 45000, -61000, 62500, 63000 };
+	long trimmed;
+	long offset;
+	int i;
+
+	mutex_lock(&priv->lock);
+	for (i = 0; i < ARRAY_SIZE(offsets); i++) {
+		KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, offsets[i]), 0);
+		trimmed = isl12020_trim_to_offset(ctx->chip.regs[ISL_REG_CSR_ITRO]);
+		KUNIT_EXPECT_LE(test, abs(trimmed - offsets[i]), TRIM_IATR_STEP_PPB / 2);
+		KUNIT_EXPECT_EQ(test, isl12020_get_trim(priv, &offset), 0);
+		KUNIT_EXPECT_EQ(test, offset, trimmed);
+	}
+
+	/* the coarse digital step is only used if the analog one can not reach the offset */
+	KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, 5000), 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_ITRO], TRIM_IATR_NOMINAL - 5);
+	KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, 60000), 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_ITRO],
+			FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, 1) | 2);
+
+	/* one write per offset, reading it back is served by the register cache */
+	ctx->chip.reads = 0;
+	ctx->chip.writes = 0;
+	KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, 60000), 0);
+	KUNIT_EXPECT_EQ(test, isl12020_get_trim(priv, &offset), 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 0);
+
+	/* out of range offsets leave the register alone */
+	KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, 64000), -ERANGE);
+	KUNIT_EXPECT_EQ(test, isl12020_set_trim(priv, -100000), -ERANGE);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_ITRO],
+			FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, 1) | 2);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+	mutex_unlock(&priv->lock);
+}
+
+static void isl12020_test_time_cache_update(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_cache_priv(test);
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	struct rtc_time tm;
+
+	/* the first read anchors the edge at the end of the transfer */
+	rtc_time64_to_tm(TEST_TIME, &tm);
+	isl12020_time_cache_update(priv, &tm, ms_to_ktime(1000), ms_to_ktime(1100));
+	KUNIT_EXPECT_TRUE(test, cache->valid);
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 1100);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->validated), 1100);
+
+	/* a read one second later proves the edge happened 40 ms earlier */
+	rtc_time64_to_tm(TEST_TIME + 1, &tm);
+	isl12020_time_cache_update(priv, &tm, ms_to_ktime(2050), ms_to_ktime(2060));
+	KUNIT_EXPECT_TRUE(test, cache->valid);
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 1);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 2060);
+
+	/* a read with a looser bound keeps the anchor found before */
+	rtc_time64_to_tm(TEST_TIME + 3, &tm);
+	isl12020_time_cache_update(priv, &tm, ms_to_ktime(4070), ms_to_ktime(4080));
+	KUNIT_EXPECT_TRUE(test, cache->valid);
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 3);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 4060);
+
+	/* the next edge can not be before the read, the time jumped, re-anchor */
+	rtc_time64_to_tm(TEST_TIME + 3, &tm);
+	isl12020_time_cache_update(priv, &tm, ms_to_ktime(5200), ms_to_ktime(5210));
+	KUNIT_EXPECT_TRUE(test, cache->valid);
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 3);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 5210);
+}
+
+static void isl12020_test_time_cache_edge(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_cache_priv(test);
+	struct isl12020_time_cache *cache = &priv->time_cache;
+
+	/* edges are ignored without an anchor */
+	isl12020_time_cache_edge(priv, ms_to_ktime(1000));
+	KUNIT_EXPECT_FALSE(test, cache->valid);
+
+	cache->valid = true;
+	cache->secs = TEST_TIME;
+	cache->stamp = ms_to_ktime(1100);
+
+	/* an edge after the estimated one belongs to the next second */
+	isl12020_time_cache_edge(priv, ms_to_ktime(2099));
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 1);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 2099);
+
+	/* exactly one second later */
+	isl12020_time_cache_edge(priv, ms_to_ktime(3099));
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 2);
+
+	/* an edge before the estimated one only corrects the stamp */
+	isl12020_time_cache_edge(priv, ms_to_ktime(2950));
+	KUNIT_EXPECT_EQ(test, cache->secs, TEST_TIME + 2);
+	KUNIT_EXPECT_EQ(test, ktime_to_ms(cache->stamp), 2950);
+}
+
+static void isl12020_test_time_cache_get(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_cache_priv(test);
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	ktime_t now = ktime_get();
+	struct rtc_time tm;
+
+	cache->valid = true;
+	cache->secs = TEST_TIME;
+	cache->stamp = ktime_sub_ms(now, 1500);
+	cache->validated = now;
+
+	/* disabled by default */
+	KUNIT_EXPECT_FALSE(test, isl12020_time_cache_get(priv, &tm));
+	KUNIT_EXPECT_EQ(test, cache->bus_reads, 1);
+
+	cache->interval = 10;
+	KUNIT_ASSERT_TRUE(test, isl12020_time_cache_get(priv, &tm));
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME + 1);
+	KUNIT_EXPECT_EQ(test, cache->hits, 1);
+
+	/* a stale anchor goes back to the bus */
+	cache->validated = ktime_sub_ms(now, 11 * MSEC_PER_SEC);
+	KUNIT_EXPECT_FALSE(test, isl12020_time_cache_get(priv, &tm));
+	KUNIT_EXPECT_EQ(test, cache->bus_reads, 2);
+}
+
+static void isl12020_test_timestamp(struct kunit *test)
+{
+	static const u8 stamp[] = { 0x56, 0x34, 0x12, 0x15, 0x06 };
+	static const u8 flagged[] = { 0xd6, 0xb4, 0x92, 0x15, 0x06 };
+	static const u8 zero[sizeof(stamp)];
+	struct rtc_time tm;
+
+	/* no switch since the flags were cleared */
+	KUNIT_EXPECT_FALSE(test, isl12020_timestamp_to_tm(zero, TEST_TIME, &tm));
+
+	/* same year if not in the future */
+	KUNIT_ASSERT_TRUE(test, isl12020_timestamp_to_tm(stamp, TEST_TIME, &tm));
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+	KUNIT_ASSERT_TRUE(test, isl12020_timestamp_to_tm(stamp, TEST_TIME + 86400 * 30, &tm));
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+
+	/* a stamp later in the year than now is from last year */
+	KUNIT_ASSERT_TRUE(test, isl12020_timestamp_to_tm(stamp, TEST_TIME - 1, &tm));
+	KUNIT_EXPECT_EQ(test, tm.tm_year, 122);
+	KUNIT_EXPECT_EQ(test, tm.tm_mon, 5);
+	KUNIT_EXPECT_EQ(test, tm.tm_mday, 15);
+	KUNIT_EXPECT_EQ(test, tm.tm_hour, 12);
+	KUNIT_EXPECT_EQ(test, tm.tm_min, 34);
+	KUNIT_EXPECT_EQ(test, tm.tm_sec, 56);
+
+	/* bits outside the time fields are masked */
+	KUNIT_ASSERT_TRUE(test, isl12020_timestamp_to_tm(flagged, TEST_TIME, &tm));
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+}
+
+static void isl12020_test_probe_defaults(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct isl12020_bus_counters *counters;
+	struct isl12020_data *priv;
+
+	priv = isl12020_test_probe(test, NULL);
+	KUNIT_EXPECT_EQ(test, priv->bus_mode, ISL12020_BUS_MODE_I2C);
+	KUNIT_EXPECT_EQ(test, priv->config.freq_out_mode, 0);
+	KUNIT_EXPECT_FALSE(test, priv->config.freq_out_bat);
+	KUNIT_EXPECT_FALSE(test, priv->config.tse);
+	KUNIT_EXPECT_FALSE(test, priv->status.rtcf);
+
+	/* the time and control/status block in one transfer, nothing to write */
+	counters = &priv->bus_stats.path[ISL12020_BUS_PROBE];
+	KUNIT_EXPECT_EQ(test, counters->transfers, 1);
+	KUNIT_EXPECT_EQ(test, counters->bytes, 1 + ISL_REG_INIT_LEN);
+	KUNIT_EXPECT_EQ(test, counters->errors, 0);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_CONFIG].transfers, 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_INT],
+			ISL_BIT_CSR_INT_WRTC | ISL_BIT_CSR_INT_FOBATB);
+}
+
+static void isl12020_test_probe_properties(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct isl12020_data *priv;
+
+	ctx->chip.regs[ISL_REG_CSR_SR] = ISL_BIT_CSR_SR_RTCF;
+
+	priv = isl12020_test_probe(test, &isl12020_test_node);
+	KUNIT_EXPECT_TRUE(test, priv->status.rtcf);
+	KUNIT_EXPECT_EQ(test, priv->time_cache.interval, 5);
+
+	/* the frequency output is applied by the probe */
+	KUNIT_EXPECT_EQ(test, priv->config.freq_out_mode, 1);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_INT] & MASK4BITS, 1);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_PROBE].transfers, 2);
+
+	/* both temperature sensor properties end up in a single write of the setup work */
+	KUNIT_EXPECT_TRUE(test, priv->config.tse);
+	KUNIT_EXPECT_TRUE(test, priv->config.btse);
+	KUNIT_EXPECT_FALSE(test, priv->config.btsr);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_BETA],
+			ISL_BIT_CSR_BETA_TSE | ISL_BIT_CSR_BETA_BTSE);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_CONFIG].transfers, 1);
+}
+
+static void isl12020_test_read_time(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct device *dev;
+	struct rtc_time tm;
+
+	isl12020_test_probe(test, NULL);
+	dev = &ctx->client->dev;
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_valid_tm(&tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+	KUNIT_EXPECT_EQ(test, tm.tm_wday, 4);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 1);
+
+	/* the time cache is disabled by default, the chip is read again */
+	isl12020_test_chip_tick(&ctx->chip);
+	isl12020_test_chip_tick(&ctx->chip);
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME + 2);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 2);
+}
+
+static void isl12020_test_read_time_byte(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct device *dev;
+	struct isl12020_data *priv;
+	struct rtc_time tm;
+
+	ctx->chip.func = TEST_FUNC_BYTE;
+	priv = isl12020_test_probe(test, NULL);
+	KUNIT_ASSERT_EQ(test, priv->bus_mode, ISL12020_BUS_MODE_BYTE);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_PROBE].transfers,
+			ISL_REG_INIT_LEN);
+	dev = &ctx->client->dev;
+
+	/* no rollover, the seconds are read once more to make sure */
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, ISL_REG_RTC_DW + 2);
+
+	/* the minute rolls over right after the seconds were read, 12:35:59 must not show up */
+	isl12020_test_chip_set_time(&ctx->chip, TEST_TIME + 3);
+	ctx->chip.reads = 0;
+	ctx->chip.tick_after = 1;
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME + 4);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 2 * (ISL_REG_RTC_DW + 1) + 1);
+}
+
+static void isl12020_test_set_time(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	const u8 *regs = ctx->chip.regs;
+	struct isl12020_data *priv;
+	struct device *dev;
+	struct rtc_time tm;
+
+	/* power-on state, the time does not count and the time registers take no writes */
+	isl12020_test_chip_set_time(&ctx->chip, 946684800LL);
+	ctx->chip.regs[ISL_REG_CSR_INT] = ISL_BIT_CSR_INT_FOBATB;
+	ctx->chip.regs[ISL_REG_CSR_SR] = ISL_BIT_CSR_SR_RTCF;
+	priv = isl12020_test_probe(test, NULL);
+	dev = &ctx->client->dev;
+	KUNIT_EXPECT_TRUE(test, priv->status.rtcf);
+
+	KUNIT_EXPECT_EQ(test, regmap_write(priv->regmap, ISL_REG_RTC_SC, 0x30), 0);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_SC], 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.ignored, 1);
+
+	/* WRTC once, then every time register on its own, SC first */
+	rtc_time64_to_tm(TEST_LEAP_TIME, &tm);
+	ctx->chip.writes = 0;
+	ctx->chip.ignored = 0;
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_set_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_SC], 0x58);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_MN], 0x59);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_HR], 0x23 | ISL_BIT_RTC_HR_MIL);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_DT], 0x29);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_MO], 0x02);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_YR], 0x24);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_RTC_DW], 4);
+	KUNIT_EXPECT_TRUE(test, regs[ISL_REG_CSR_INT] & ISL_BIT_CSR_INT_WRTC);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1 + ISL_REG_RTC_DW + 1);
+	KUNIT_EXPECT_EQ(test, ctx->chip.ignored, 0);
+	KUNIT_EXPECT_GE(test, priv->rtc->set_offset_nsec, NSEC_PER_SEC);
+
+	/* the status work is kicked and picks up the cleared RTCF */
+	flush_delayed_work(&priv->status_work);
+	KUNIT_EXPECT_FALSE(test, regs[ISL_REG_CSR_SR] & ISL_BIT_CSR_SR_RTCF);
+	KUNIT_EXPECT_FALSE(test, priv->status.rtcf);
+
+	/* the time has to come back from the chip, not from a cache, over the leap day */
+	isl12020_test_chip_tick(&ctx->chip);
+	isl12020_test_chip_tick(&ctx->chip);
+	memset(&tm, 0, sizeof(tm));
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_LEAP_TIME + 2);
+	KUNIT_EXPECT_EQ(test, tm.tm_mon, 2);
+	KUNIT_EXPECT_EQ(test, tm.tm_wday, 5);
+
+	/* WRTC is known to be set, the next set_time() leaves it alone */
+	ctx->chip.writes = 0;
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_set_time(dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, ISL_REG_RTC_DW + 1);
+	flush_delayed_work(&priv->status_work);
+}
+
+static void isl12020_test_set_beta(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_probe(test, NULL);
+	struct isl12020_test_ctx *ctx = test->priv;
+	bool changed;
+
+	mutex_lock(&priv->lock);
+	KUNIT_EXPECT_EQ(test, isl12020_set_beta(priv, true, true, false, &changed), 0);
+	KUNIT_EXPECT_TRUE(test, changed);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_BETA],
+			ISL_BIT_CSR_BETA_TSE | ISL_BIT_CSR_BETA_BTSE);
+
+	/* nothing changes, the register cache skips the write */
+	KUNIT_EXPECT_EQ(test, isl12020_set_beta(priv, true, true, false, &changed), 0);
+	KUNIT_EXPECT_FALSE(test, changed);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+
+	KUNIT_EXPECT_EQ(test, isl12020_set_beta(priv, false, true, true, &changed), 0);
+	KUNIT_EXPECT_TRUE(test, changed);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 2);
+	KUNIT_EXPECT_EQ(test, ctx->chip.regs[ISL_REG_CSR_BETA],
+			ISL_BIT_CSR_BETA_BTSE | ISL_BIT_CSR_BETA_BTSR);
+	mutex_unlock(&priv->lock);
+
+	KUNIT_EXPECT_FALSE(test, priv->config.tse);
+	KUNIT_EXPECT_TRUE(test, priv->config.btse);
+	KUNIT_EXPECT_TRUE(test, priv->config.btsr);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 0);
+}
+
+static void isl12020_test_read_temp(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_probe(test, NULL);
+	struct isl12020_test_ctx *ctx = test->priv;
+	long val;
+
+	/* the sensor values are not valid without TSE */
+	KUNIT_EXPECT_EQ(test, isl12020_read_temp(priv, &val), -EOPNOTSUPP);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 0);
+
+	mutex_lock(&priv->lock);
+	KUNIT_ASSERT_EQ(test, isl12020_set_beta(priv, true, false, false, NULL), 0);
+	mutex_unlock(&priv->lock);
+
+	KUNIT_ASSERT_EQ(test, isl12020_read_temp(priv, &val), 0);
+	KUNIT_EXPECT_EQ(test, val, 25000);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 1);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_TEMP].bytes, 3);
+
+	/* no new conversion within the sensing period, the cache answers */
+	ctx->chip.regs[ISL_REG_TEMP_TKOL] = (TEST_TEMP_RAW + 4) & 0xff;
+	KUNIT_ASSERT_EQ(test, isl12020_read_temp(priv, &val), 0);
+	KUNIT_EXPECT_EQ(test, val, 25000);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 1);
+
+	/* a new sensing period drops the cached value */
+	mutex_lock(&priv->lock);
+	KUNIT_ASSERT_EQ(test, isl12020_set_beta(priv, true, false, true, NULL), 0);
+	mutex_unlock(&priv->lock);
+	KUNIT_ASSERT_EQ(test, isl12020_read_temp(priv, &val), 0);
+	KUNIT_EXPECT_EQ(test, val, 27000);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 2);
+
+	/* and switching it off makes the value unavailable again */
+	mutex_lock(&priv->lock);
+	KUNIT_ASSERT_EQ(test, isl12020_set_beta(priv, false, false, true, NULL), 0);
+	mutex_unlock(&priv->lock);
+	KUNIT_EXPECT_EQ(test, isl12020_read_temp(priv, &val), -EOPNOTSUPP);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 2);
+}
+
+static void isl12020_test_sysfs_store(struct kunit *test)
+{
+	struct isl12020_data *priv = isl12020_test_probe(test, NULL);
+	struct isl12020_test_ctx *ctx = test->priv;
+	const u8 *regs = ctx->chip.regs;
+	char *buf;
+
+	/* sysfs_emit() wants a whole page */
+	buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "temperature_sensor_enabled", "1\n", NULL),
+			2);
+	KUNIT_EXPECT_TRUE(test, regs[ISL_REG_CSR_BETA] & ISL_BIT_CSR_BETA_TSE);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "temperature_sensor_enabled", NULL, buf),
+			2);
+	KUNIT_EXPECT_STREQ(test, buf, "1\n");
+
+	/* storing the current value costs nothing, invalid values are rejected before the bus */
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "temperature_sensor_enabled", "1", NULL),
+			1);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "high_sensing_frequency", "maybe", NULL),
+			-EINVAL);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 1);
+
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "battery_temperature_sensor_enabled", "1",
+						 NULL), 1);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "high_sensing_frequency", "1", NULL), 1);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_CSR_BETA], ISL_BIT_CSR_BETA_TSE |
+			ISL_BIT_CSR_BETA_BTSE | ISL_BIT_CSR_BETA_BTSR);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 3);
+
+	/* the frequency output and its battery mode share INT, FOBATB is reversed */
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "frequency_output", "16", NULL), -ERANGE);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "frequency_output", "1", NULL), 1);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "frequency_output", "1", NULL), 1);
+	KUNIT_EXPECT_EQ(test, regs[ISL_REG_CSR_INT] & MASK4BITS, 1);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 4);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "battery_frequency_output_enabled", "1",
+						 NULL), 1);
+	KUNIT_EXPECT_FALSE(test, regs[ISL_REG_CSR_INT] & ISL_BIT_CSR_INT_FOBATB);
+	KUNIT_EXPECT_TRUE(test, priv->config.freq_out_bat);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 5);
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "frequency_output", NULL, buf), 13);
+	KUNIT_EXPECT_STREQ(test, buf, "1 (32768 Hz)\n");
+
+	/* the time cache lives in memory only */
+	KUNIT_EXPECT_EQ(test, isl12020_test_attr(test, "time_cache_interval", "5", NULL), 1);
+	KUNIT_EXPECT_EQ(test, priv->time_cache.interval, 5);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, 5);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 0);
+}
+
+static void isl12020_test_bus_block(struct kunit *test)
+{
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct isl12020_bus_counters *counters;
+	struct isl12020_data *priv;
+	struct rtc_time tm;
+	u8 *buf;
+	int i;
+
+	buf = kunit_kzalloc(test, ISL_USR_LEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+	for (i = 0; i < ISL_USR_LEN; i++)
+		buf[i] = i ^ 0x5a;
+
+	ctx->chip.func = TEST_FUNC_BLOCK;
+	priv = isl12020_test_probe(test, NULL);
+	KUNIT_ASSERT_EQ(test, priv->bus_mode, ISL12020_BUS_MODE_BLOCK);
+	KUNIT_EXPECT_EQ(test, priv->bus_stats.path[ISL12020_BUS_PROBE].transfers, 1);
+
+	KUNIT_ASSERT_EQ(test, isl12020_rtc_ops_read_time(&ctx->client->dev, &tm), 0);
+	KUNIT_EXPECT_EQ(test, rtc_tm_to_time64(&tm), TEST_TIME);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 1);
+
+	/* the user sram in blocks of 32 bytes, each one with its own register address */
+	KUNIT_ASSERT_EQ(test, isl12020_nvmem_write(priv, 0, buf, ISL_USR_LEN), 0);
+	KUNIT_EXPECT_MEMEQ(test, &ctx->chip.regs[ISL_REG_USR_START], buf, ISL_USR_LEN);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, ISL_USR_LEN / I2C_SMBUS_BLOCK_MAX);
+
+	memset(buf, 0, ISL_USR_LEN);
+	KUNIT_ASSERT_EQ(test, isl12020_nvmem_read(priv, 0, buf, ISL_USR_LEN), 0);
+	KUNIT_EXPECT_MEMEQ(test, &ctx->chip.regs[ISL_REG_USR_START], buf, ISL_USR_LEN);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, 1 + ISL_USR_LEN / I2C_SMBUS_BLOCK_MAX);
+
+	counters = &priv->bus_stats.path[ISL12020_BUS_NVMEM];
+	KUNIT_EXPECT_EQ(test, counters->transfers, 2 * ISL_USR_LEN / I2C_SMBUS_BLOCK_MAX);
+	KUNIT_EXPECT_EQ(test, counters->bytes,
+			2 * (ISL_USR_LEN + ISL_USR_LEN / I2C_SMBUS_BLOCK_MAX));
+	KUNIT_EXPECT_EQ(test, counters->errors, 0);
+}
+
+static void isl12020_test_bus_quirks(struct kunit *test)
+{
+	const size_t reads = DIV_ROUND_UP(ISL_USR_LEN, isl12020_test_quirks.max_read_len);
+	const size_t writes = DIV_ROUND_UP(ISL_USR_LEN, isl12020_test_quirks.max_write_len - 1);
+	struct isl12020_test_ctx *ctx = test->priv;
+	struct isl12020_bus_counters *counters;
+	struct isl12020_data *priv;
+	u8 *buf;
+	int i;
+
+	buf = kunit_kzalloc(test, ISL_USR_LEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+	for (i = 0; i < ISL_USR_LEN; i++)
+		buf[i] = ~i;
+
+	/* the i2c core rejects every transfer beyond the limits */
+	ctx->chip.adap.quirks = &isl12020_test_quirks;
+	priv = isl12020_test_probe(test, NULL);
+	KUNIT_ASSERT_EQ(test, priv->bus_mode, ISL12020_BUS_MODE_I2C);
+	counters = &priv->bus_stats.path[ISL12020_BUS_PROBE];
+	KUNIT_EXPECT_EQ(test, counters->transfers,
+			DIV_ROUND_UP(ISL_REG_INIT_LEN, isl12020_test_quirks.max_read_len));
+	KUNIT_EXPECT_EQ(test, counters->errors, 0);
+
+	KUNIT_ASSERT_EQ(test, isl12020_nvmem_write(priv, 0, buf, ISL_USR_LEN), 0);
+	KUNIT_EXPECT_MEMEQ(test, &ctx->chip.regs[ISL_REG_USR_START], buf, ISL_USR_LEN);
+	KUNIT_EXPECT_EQ(test, ctx->chip.writes, writes);
+
+	memset(buf, 0, ISL_USR_LEN);
+	KUNIT_ASSERT_EQ(test, isl12020_nvmem_read(priv, 0, buf, ISL_USR_LEN), 0);
+	KUNIT_EXPECT_MEMEQ(test, &ctx->chip.regs[ISL_REG_USR_START], buf, ISL_USR_LEN);
+	KUNIT_EXPECT_EQ(test, ctx->chip.reads, reads);
+
+	counters = &priv->bus_stats.path[ISL12020_BUS_NVMEM];
+	KUNIT_EXPECT_EQ(test, counters->transfers, reads + writes);
+	KUNIT_EXPECT_EQ(test, counters->bytes, 2 * ISL_USR_LEN + reads + writes);
+	KUNIT_EXPECT_EQ(test, counters->errors, 0);
+}
+
+static struct kunit_case isl12020_test_cases[] = {
+	KUNIT_CASE(isl12020_test_trim_to_offset),
+	KUNIT_CASE(isl12020_test_set_trim),
+	KUNIT_CASE(isl12020_test_time_cache_update),
+	KUNIT_CASE(isl12020_test_time_cache_edge),
+	KUNIT_CASE(isl12020_test_time_cache_get),
+	KUNIT_CASE(isl12020_test_timestamp),
+	KUNIT_CASE(isl12020_test_probe_defaults),
+	KUNIT_CASE(isl12020_test_probe_properties),
+	KUNIT_CASE(isl12020_test_read_time),
+	KUNIT_CASE(isl12020_test_read_time_byte),
+	KUNIT_CASE(isl12020_test_set_time),
+	KUNIT_CASE(isl12020_test_set_beta),
+	KUNIT_CASE(isl12020_test_read_temp),
+	KUNIT_CASE(isl12020_test_sysfs_store),
+	KUNIT_CASE(isl12020_test_bus_block),
+	KUNIT_CASE(isl12020_test_bus_quirks),
+	{ }
+};
+
+static struct kunit_suite isl12020_test_suite = {
+	.name = "rtc-isl12020",
+	.init = isl12020_test_init,
+	.test_cases = isl12020_test_cases,
+};
+kunit_test_suite(isl12020_test_suite);
+
+MODULE_LICENSE("GPL v2");
+MODULE_AUTHOR("Wilken Gottwalt <wilken.gottwalt@posteo.net>");
+MODULE_DESCRIPTION("Renesas ISL12020M RTC I2C driver kunit tests");
+MODULE_IMPORT_NS("EXPORTED_FOR_KUNIT_TESTING");
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * rtc-isl12020 - Renesas ISL12020M RTC I2C driver tracepoints
+ * Copyright (C) 2023 Wilken Gottwalt <wilken.gottwalt@posteo.net>
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM isl12020
+
+#if !defined(_RTC_ISL12020_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RTC_ISL12020_TRACE_H
+
+#include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#define ISL12020_TRACE_RAW_MAX	8
+
+/* bulk accesses of a register range, raw is NULL and len 0 if served from a cache */
+DECLARE_EVENT_CLASS(isl12020_regs,
+	TP_PROTO(struct device *dev, u8 reg, const u8 *raw, u8 len, int err, ktime_t duration),
+	TP_ARGS(dev, reg, raw, len, err, duration),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u8, reg)
+		__field(u8, len)
+		__array(u8, raw, ISL12020_TRACE_RAW_MAX)
+		__field(int, err)
+		__field(s64, duration)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->reg = reg;
+		__entry->len = min_t(u8, raw ? len : 0, ISL12020_TRACE_RAW_MAX);
+		memset(__entry->raw, 0, ISL12020_TRACE_RAW_MAX);
+		if (raw)
+			memcpy(__entry->raw, raw, __entry->len);
+		__entry->err = err;
+		__entry->duration = ktime_to_ns(duration);
+	),
+
+	TP_printk("%s reg=0x%02x len=%u raw=%*ph err=%d duration=%lld ns", __get_str(dev),
+		  __entry->reg, __entry->len, __entry->len, __entry->raw, __entry->err,
+		  __entry->duration)
+);
+
+DEFINE_EVENT(isl12020_regs, isl12020_read_time,
+	TP_PROTO(struct device *dev, u8 reg, const u8 *raw, u8 len, int err, ktime_t duration),
+	TP_ARGS(dev, reg, raw, len, err, duration)
+);
+
+DEFINE_EVENT(isl12020_regs, isl12020_set_time,
+	TP_PROTO(struct device *dev, u8 reg, const u8 *raw, u8 len, int err, ktime_t duration),
+	TP_ARGS(dev, reg, raw, len, err, duration)
+);
+
+DEFINE_EVENT(isl12020_regs, isl12020_read_temp,
+	TP_PROTO(struct device *dev, u8 reg, const u8 *raw, u8 len, int err, ktime_t duration),
+	TP_ARGS(dev, reg, raw, len, err, duration)
+);
+
+/* read-modify-write of config bits, changed is false if the write was skipped */
+DECLARE_EVENT_CLASS(isl12020_update,
+	TP_PROTO(struct device *dev, u8 reg, u8 mask, u8 val, bool changed, int err,
+		 ktime_t duration),
+	TP_ARGS(dev, reg, mask, val, changed, err, duration),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u8, reg)
+		__field(u8, mask)
+		__field(u8, val)
+		__field(bool, changed)
+		__field(int, err)
+		__field(s64, duration)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->reg = reg;
+		__entry->mask = mask;
+		__entry->val = val;
+		__entry->changed = changed;
+		__entry->err = err;
+		__entry->duration = ktime_to_ns(duration);
+	),
+
+	TP_printk("%s reg=0x%02x mask=0x%02x val=0x%02x changed=%d err=%d duration=%lld ns",
+		  __get_str(dev), __entry->reg, __entry->mask, __entry->val, __entry->changed,
+		  __entry->err, __entry->duration)
+);
+
+DEFINE_EVENT(isl12020_update, isl12020_set_beta,
+	TP_PROTO(struct device *dev, u8 reg, u8 mask, u8 val, bool changed, int err,
+		 ktime_t duration),
+	TP_ARGS(dev, reg, mask, val, changed, err, duration)
+);
+
+DEFINE_EVENT(isl12020_update, isl12020_set_freq_out,
+	TP_PROTO(struct device *dev, u8 reg, u8 mask, u8 val, bool changed, int err,
+		 ktime_t duration),
+	TP_ARGS(dev, reg, mask, val, changed, err, duration)
+);
+
+#endif /* _RTC_ISL12020_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rtc-isl12020-trace
+#include <trace/define_trace.h>
@@ -5,161 +5,685 @@
  */
 
 #include <linux/bcd.h>
+#include <linux/bitfield.h>
 #include <linux/bits.h>
+#include <linux/clk-provider.h>
+#include <linux/debugfs.h>
+#include <linux/devm-helpers.h>
 #include <linux/err.h>
+#include <linux/gpio/consumer.h>
 #include <linux/hwmon.h>
 #include <linux/i2c.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/kobject.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/nvmem-provider.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/pm.h>
+#include <linux/pm_wakeup.h>
+#include <linux/pps_kernel.h>
 #include <linux/regmap.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/sysfs.h>
 #include <linux/types.h>
+#include <linux/util_macros.h>
+#include <linux/workqueue.h>
+#include <kunit/visibility.h>
 
-#define INTERNAL_NAME		"isl12020"
-#define DRIVER_NAME		"rtc-" INTERNAL_NAME
-
-#define MASK3BITS		GENMASK(2, 0)
-#define MASK4BITS		GENMASK(3, 0)
-#define MASK5BITS		GENMASK(4, 0)
-#define MASK6BITS		GENMASK(5, 0)
-#define MASK7BITS		GENMASK(6, 0)
-
-#define CENTURY_LEN		100
-#define MONTH_OFFSET		1
-
-#define MILLI_DEGREE_CELCIUS	1000
-#define CELCIUS0		(369 * MILLI_DEGREE_CELCIUS)
-#define CELCIUS0_M		(273 * MILLI_DEGREE_CELCIUS)
-#define TEMP_MIN		(-20 * MILLI_DEGREE_CELCIUS)
-#define TEMP_MIN_M		(-40 * MILLI_DEGREE_CELCIUS)
-#define TEMP_LCRIT		(-40 * MILLI_DEGREE_CELCIUS)
-#define TEMP_LCRIT_M		(-50 * MILLI_DEGREE_CELCIUS)
-#define TEMP_MAX		(75 * MILLI_DEGREE_CELCIUS)
-#define TEMP_MAX_M		(85 * MILLI_DEGREE_CELCIUS)
-#define TEMP_CRIT		(85 * MILLI_DEGREE_CELCIUS)
-#define TEMP_CRIT_M		(90 * MILLI_DEGREE_CELCIUS)
-
-#define FREQ_OUT_MODE_MAX	GENMASK(3, 0)
-
-/* ISL12020M register offsets */
-#define ISL_REG_RTC_SC		0x00 /* bit 0-6 = seconds 0-59, default 0x00 */
-#define ISL_REG_RTC_MN		0x01 /* bit 0-6 = minutes 0-59, default 0x00 */
-#define ISL_REG_RTC_HR		0x02 /* bit 0-5 = hours 0-23, bit 7 = 24 hour time, default 0x00 */
-#define ISL_REG_RTC_DT		0x03 /* bit 0-5 = days 1-31, default 0x01 */
-#define ISL_REG_RTC_MO		0x04 /* bit 0-4 = months 1-12, default 0x01 */
-#define ISL_REG_RTC_YR		0x05 /* bit 0-7 = years 0-99, default 0x00 */
-#define ISL_REG_RTC_DW		0x06 /* bit 0-2 = day of week 0-6, default 0x00 */
-
-#define ISL_REG_CSR_SR		0x07
-#define ISL_REG_CSR_INT		0x08
-#define ISL_REG_CSR_PWRVDD	0x09
-#define ISL_REG_CSR_PWRBAT	0x0A
-#define ISL_REG_CSR_BETA	0x0D
-
-#define ISL_REG_TEMP_TKOL	0x28 /* bit 0-7 = lower part of 10bit temperature */
-#define ISL_REG_TEMP_TKOM	0x29 /* bit 0-1 = upper part of 10bit temperature */
-
-/* ISL12020M bits  */
-#define ISL_BIT_RTC_HR_MIL	BIT(7)
-
-#define ISL_BIT_CSR_SR_OSCF	BIT(7)
-#define ISL_BIT_CSR_SR_RTCF	BIT(0)
-#define ISL_BIT_CSR_INT_WRTC	BIT(6)
-#define ISL_BIT_CSR_INT_FOBATB	BIT(4)
-#define ISL_BIT_CSR_BETA_TSE	BIT(7)
-#define ISL_BIT_CSR_BETA_BTSE	BIT(6)
-#define ISL_BIT_CSR_BETA_BTSR	BIT(5)
+#include "rtc-isl12020.h"
+
+#define CREATE_TRACE_POINTS
+#include "rtc-isl12020-trace.h"
+
+/* rates of the integer Hz modes, the sub 1 Hz modes can not be expressed as clock rate */
+static const unsigned long freq_out_rates[] = {
+	0, 32768, 4096, 1024, 64, 32, 16, 8, 4, 2, 1,
+};
 
 static const char *const freq_out_modes[] = {
 	"off", "32768", "4096", "1024", "64", "32", "16", "8", "4", "2", "1", "1/2", "1/4", "1/8",
 	"1/16", "1/32",
 };
 
-struct isl12020_status {
-	bool oscf;			/* oscillator failure */
-	bool rtcf;			/* rtc failure due low voltage or oscillator failure */
-	bool power_triggers_checked;	/* checking lvdd and lbat* only after setting TSE */
-	bool lvdd;			/* low voltage on normal power line */
-	bool lbat85;			/* low voltage on battery first trigger */
-	bool lbat75;			/* low voltage on battery second trigger */
+static const char *const bus_mode_names[] = {
+	"i2c", "smbus i2c block", "smbus byte",
 };
 
-struct isl12020_config {
-	u8 freq_out_mode;
-	bool freq_out_bat;
-	bool tse;
-	bool btse;
-	bool btsr;
+static const char *const bus_path_names[] = {
+	"probe", "read_time", "set_time", "hwmon_temp", "config", "alarm_status", "nvmem",
+	"snapshot",
 };
 
-struct isl12020_data {
-	struct i2c_client *client;
-	struct rtc_device *rtc;
-	struct regmap *regmap;
-	struct device *hwmon_dev;
-	struct isl12020_status status;
-	struct isl12020_config config;
+static const char *const event_names[] = {
+	"LVDD", "LBAT85", "LBAT75", "OSCF",
+};
+
+/* trip points in mV, selected by the PWRVDD and PWRBAT register fields */
+static const int vdd_trip_levels[] = { 2295, 2550, 2805, 3060, 4250, 4675 };
+static const int vb85_trip_levels[] = { 2125, 2295, 2550, 2805, 3060, 4250, 4675 };
+static const int vb75_trip_levels[] = { 1875, 2025, 2250, 2475, 2700, 3750, 4125 };
+
+static const char *const in_labels[] = {
+	"vdd", "battery",
 };
 
-static int isl12020_set_beta(struct isl12020_data *priv, bool tse, bool btse, bool btsr)
+static const char *const calib_states[] = {
+	"idle", "running", "done", "failed",
+};
+
+static void isl12020_get_config(struct isl12020_data *priv, struct isl12020_config *config)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&priv->seq);
+		*config = priv->config;
+	} while (read_seqcount_retry(&priv->seq, seq));
+}
+
+static void isl12020_get_status(struct isl12020_data *priv, struct isl12020_status *status)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&priv->seq);
+		*status = priv->status;
+	} while (read_seqcount_retry(&priv->seq, seq));
+}
+
+/*
+ * the register cache turns these into a single write, which is skipped if nothing changes,
+ * callers have to hold priv->lock, readers only see the config after the bus access finished
+ */
+VISIBLE_IF_KUNIT int isl12020_set_beta(struct isl12020_data *priv, bool tse, bool btse,
+				       bool btsr, bool *changed)
 {
-	int val;
+	const u8 mask = ISL_BIT_CSR_BETA_TSE | ISL_BIT_CSR_BETA_BTSE | ISL_BIT_CSR_BETA_BTSR;
+	ktime_t start = ktime_get();
+	unsigned int val = 0;
+	bool written = false;
 	int err;
 
-	err = regmap_read(priv->regmap, ISL_REG_CSR_BETA, &val);
-	if (err == 0) {
-		val = tse ? (val | ISL_BIT_CSR_BETA_TSE) : (val & ~ISL_BIT_CSR_BETA_TSE);
-		val = btse ? (val | ISL_BIT_CSR_BETA_BTSE) : (val & ~ISL_BIT_CSR_BETA_BTSE);
-		val = btsr ? (val | ISL_BIT_CSR_BETA_BTSR) : (val & ~ISL_BIT_CSR_BETA_BTSR);
+	lockdep_assert_held(&priv->lock);
 
-		err = regmap_write(priv->regmap, ISL_REG_CSR_BETA, val);
-		if (!err) {
-			priv->config.tse = tse;
-			priv->config.btse = btse;
-			priv->config.btsr = btsr;
-		} else {
-			dev_warn(&priv->client->dev, "BETA register writing failed (%d)\n", err);
-		}
+	val |= tse ? ISL_BIT_CSR_BETA_TSE : 0;
+	val |= btse ? ISL_BIT_CSR_BETA_BTSE : 0;
+	val |= btsr ? ISL_BIT_CSR_BETA_BTSR : 0;
+
+	err = regmap_update_bits_check(priv->regmap, ISL_REG_CSR_BETA, mask, val, &written);
+	trace_isl12020_set_beta(&priv->client->dev, ISL_REG_CSR_BETA, mask, val, written, err,
+				ktime_sub(ktime_get(), start));
+	if (changed)
+		*changed = written;
+	if (!err) {
+		/* the sensor restarts or changes its period */
+		if (tse != priv->config.tse || btsr != priv->config.btsr)
+			priv->temp_cache.valid = false;
+		write_seqcount_begin(&priv->seq);
+		priv->config.tse = tse;
+		priv->config.btse = btse;
+		priv->config.btsr = btsr;
+		write_seqcount_end(&priv->seq);
 	} else {
-		dev_warn(&priv->client->dev, "BETA register reading failed (%d)\n", err);
+		dev_warn(&priv->client->dev, "BETA register update failed (%d)\n", err);
 	}
 
 	return err;
 }
+EXPORT_SYMBOL_IF_KUNIT(isl12020_set_beta);
 
-static int isl12020_set_freq_out(struct isl12020_data *priv, u8 mode, bool batmode)
+static int isl12020_set_freq_out(struct isl12020_data *priv, u8 mode, bool batmode,
+				 bool *changed)
 {
-	int val;
+	const u8 mask = ISL_BIT_CSR_INT_FOBATB | MASK4BITS;
+	ktime_t start = ktime_get();
+	bool written = false;
+	unsigned int val;
 	int err;
 
-	err = regmap_read(priv->regmap, ISL_REG_CSR_INT, &val);
+	lockdep_assert_held(&priv->lock);
+
+	/* ISL_BIT_CSR_INT_FOBATB flag is a reversed bit */
+	val = batmode ? 0 : ISL_BIT_CSR_INT_FOBATB;
+	val |= mode & MASK4BITS;
+
+	err = regmap_update_bits_check(priv->regmap, ISL_REG_CSR_INT, mask, val, &written);
+	trace_isl12020_set_freq_out(&priv->client->dev, ISL_REG_CSR_INT, mask, val, written, err,
+				    ktime_sub(ktime_get(), start));
+	if (changed)
+		*changed = written;
 	if (!err) {
-		/* ISL_BIT_CSR_INT_FOBATB flag is a reversed bit */
-		val = batmode ? (val & ~ISL_BIT_CSR_INT_FOBATB) : (val | ISL_BIT_CSR_INT_FOBATB);
-		val &= ~MASK4BITS;
-		val |= mode & MASK4BITS;
+		write_seqcount_begin(&priv->seq);
+		priv->config.freq_out_mode = mode;
+		priv->config.freq_out_bat = batmode;
+		write_seqcount_end(&priv->seq);
+	} else {
+		dev_warn(&priv->client->dev, "INT register update failed (%d)\n", err);
+	}
 
-		err = regmap_write(priv->regmap, ISL_REG_CSR_INT, val);
-		if (!err) {
-			priv->config.freq_out_mode = mode;
-			priv->config.freq_out_bat = batmode;
+	return err;
+}
+
+/* IDTR encodes 0b01 as +30.5 ppm and 0b11 as -30.5 ppm, the others mean no correction */
+VISIBLE_IF_KUNIT long isl12020_trim_to_offset(unsigned int itro)
+{
+	long offset = (TRIM_IATR_NOMINAL - (long)FIELD_GET(ISL_MASK_CSR_ITRO_IATR, itro)) *
+		      TRIM_IATR_STEP_PPB;
+
+	switch (FIELD_GET(ISL_MASK_CSR_ITRO_IDTR, itro)) {
+	case 1:
+		return offset + TRIM_IDTR_STEP_PPB;
+	case 3:
+		return offset - TRIM_IDTR_STEP_PPB;
+	default:
+		return offset;
+	}
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_trim_to_offset);
+
+VISIBLE_IF_KUNIT int isl12020_get_trim(struct isl12020_data *priv, long *offset)
+{
+	unsigned int itro;
+	int err;
+
+	err = regmap_read(priv->regmap, ISL_REG_CSR_ITRO, &itro);
+	if (err)
+		return err;
+
+	*offset = isl12020_trim_to_offset(itro);
+
+	return 0;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_get_trim);
+
+/* try all digital steps and keep the combination closest to the requested offset */
+VISIBLE_IF_KUNIT int isl12020_set_trim(struct isl12020_data *priv, long offset)
+{
+	static const u8 idtr_codes[] = { 0, 1, 3 };
+	long best_err = LONG_MAX;
+	unsigned int itro = 0;
+	int err;
+	int i;
+
+	lockdep_assert_held(&priv->lock);
+
+	for (i = 0; i < ARRAY_SIZE(idtr_codes); i++) {
+		unsigned int code = FIELD_PREP(ISL_MASK_CSR_ITRO_IDTR, idtr_codes[i]);
+		long base = isl12020_trim_to_offset(code | TRIM_IATR_NOMINAL);
+		long iatr;
+		long delta;
+
+		iatr = TRIM_IATR_NOMINAL - DIV_ROUND_CLOSEST(offset - base, TRIM_IATR_STEP_PPB);
+		iatr = clamp_t(long, iatr, 0, FIELD_MAX(ISL_MASK_CSR_ITRO_IATR));
+		code |= FIELD_PREP(ISL_MASK_CSR_ITRO_IATR, iatr);
+		delta = abs(offset - isl12020_trim_to_offset(code));
+		if (delta < best_err) {
+			best_err = delta;
+			itro = code;
+		}
+	}
+
+	if (best_err > TRIM_IATR_STEP_PPB / 2)
+		return -ERANGE;
+
+	err = regmap_write(priv->regmap, ISL_REG_CSR_ITRO, itro);
+	if (err)
+		dev_warn(&priv->client->dev, "ITRO register update failed (%d)\n", err);
+
+	return err;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_set_trim);
+
+static void isl12020_sr_to_status(u8 sr, bool tse, struct isl12020_status *status)
+{
+	status->oscf = !!(sr & ISL_BIT_CSR_SR_OSCF);
+	status->rtcf = !!(sr & ISL_BIT_CSR_SR_RTCF);
+
+	/* the power triggers are only checked with the temperature sensor enabled */
+	status->power_triggers_checked = tse;
+	status->lvdd = tse && (sr & ISL_BIT_CSR_SR_LVDD);
+	status->lbat85 = tse && (sr & ISL_BIT_CSR_SR_LBAT85);
+	status->lbat75 = tse && (sr & ISL_BIT_CSR_SR_LBAT75);
+}
+
+static void isl12020_log_event(struct isl12020_data *priv, enum isl12020_event_category category)
+{
+	struct isl12020_event *event = &priv->events[priv->events_head];
+
+	lockdep_assert_held(&priv->lock);
+
+	event->time = ktime_get_real_seconds();
+	event->category = category;
+	priv->events_head = (priv->events_head + 1) % STATUS_EVENTS;
+	if (priv->events_count < STATUS_EVENTS)
+		priv->events_count++;
+}
+
+/* only newly raised flags are events */
+static void isl12020_log_events(struct isl12020_data *priv, const struct isl12020_status *old,
+				const struct isl12020_status *status)
+{
+	if (status->lvdd && !old->lvdd)
+		isl12020_log_event(priv, ISL12020_EVENT_LVDD);
+	if (status->lbat85 && !old->lbat85)
+		isl12020_log_event(priv, ISL12020_EVENT_LBAT85);
+	if (status->lbat75 && !old->lbat75)
+		isl12020_log_event(priv, ISL12020_EVENT_LBAT75);
+	if (status->oscf && !old->oscf)
+		isl12020_log_event(priv, ISL12020_EVENT_OSCF);
+}
+
+/* take over a freshly read SR and wake up everyone poll()ing on a changed attribute */
+static void isl12020_update_status(struct isl12020_data *priv, u8 sr)
+{
+	struct kobject *kobj = &priv->client->dev.kobj;
+	struct isl12020_status status;
+	struct isl12020_status old;
+
+	mutex_lock(&priv->lock);
+	old = priv->status;
+	isl12020_sr_to_status(sr, priv->config.tse, &status);
+	isl12020_log_events(priv, &old, &status);
+	write_seqcount_begin(&priv->seq);
+	priv->status = status;
+	write_seqcount_end(&priv->seq);
+	mutex_unlock(&priv->lock);
+
+	if (status.oscf != old.oscf)
+		sysfs_notify(kobj, NULL, "oscillator_failed");
+	if (status.rtcf != old.rtcf)
+		sysfs_notify(kobj, NULL, "rtc_failed");
+	if (status.lvdd != old.lvdd)
+		sysfs_notify(kobj, NULL, "vdd_low_voltage");
+	if (status.lbat85 != old.lbat85)
+		sysfs_notify(kobj, NULL, "battery_low_voltage_85");
+	if (status.lbat75 != old.lbat75)
+		sysfs_notify(kobj, NULL, "battery_low_voltage_75");
+}
+
+/*
+ * SR is precious, every reader has to pass what it read on, a pending alarm is delivered to the
+ * rtc core right away, returns false if there was none
+ */
+static bool isl12020_handle_sr(struct isl12020_data *priv, u8 sr)
+{
+	u8 clear = sr & ISL_BIT_CSR_SR_ALM;
+	int err;
+
+	isl12020_update_status(priv, sr);
+
+	/*
+	 * the power flags stay latched, once taken over they are cleared so the next switchover
+	 * raises them again, a lasting condition is latched again by the next sensing period
+	 */
+	if (READ_ONCE(priv->config.tse))
+		clear |= sr & (ISL_BIT_CSR_SR_LVDD | ISL_BIT_CSR_SR_LBAT85 | ISL_BIT_CSR_SR_LBAT75);
+
+	/* status bits are only cleared by writing zero, ALM releases the IRQ line */
+	if (clear) {
+		err = regmap_write(priv->regmap, ISL_REG_CSR_SR, sr & ~clear);
+		if (err)
+			dev_warn(&priv->client->dev, "clearing status flags failed (%d)\n", err);
+	}
+
+	if (!(sr & ISL_BIT_CSR_SR_ALM))
+		return false;
+
+	rtc_update_irq(priv->rtc, 1, RTC_IRQF | RTC_AF);
+
+	return true;
+}
+
+static void isl12020_status_work(struct work_struct *work)
+{
+	struct isl12020_data *priv = container_of(to_delayed_work(work), struct isl12020_data,
+						  status_work);
+	unsigned int sr;
+
+	if (!regmap_read(priv->regmap, ISL_REG_CSR_SR, &sr))
+		isl12020_handle_sr(priv, sr);
+
+	schedule_delayed_work(&priv->status_work, msecs_to_jiffies(STATUS_POLL_INTERVAL));
+}
+
+/*
+ * with an edge triggered interrupt wired to the IRQ/F_OUT line, a 1 Hz frequency output is used
+ * for update interrupts, the alarm is then handled by the rtc core on the next second edge, a
+ * level triggered interrupt would fire for the whole half period of the square wave
+ */
+static bool isl12020_uie_mode(struct isl12020_data *priv)
+{
+	return priv->client->irq > 0 && !priv->irq_level &&
+	       priv->config.freq_out_mode == FREQ_OUT_MODE_1HZ;
+}
+
+/*
+ * the interrupt may only see the IRQ/F_OUT line while it carries alarms (output off) or 1 Hz
+ * update edges, a separate pps line only 1 Hz edges, any other clock would storm the handlers
+ * until the line gets disabled for good
+ */
+static void isl12020_mask_irq(struct isl12020_data *priv, bool mask)
+{
+	bool irq_mask = mask || (priv->config.freq_out_mode && !isl12020_uie_mode(priv));
+	bool pps_mask = mask || priv->config.freq_out_mode != FREQ_OUT_MODE_1HZ;
+	int irq = priv->client->irq;
+
+	if (irq > 0 && irq_mask != priv->irq_masked) {
+		if (irq_mask)
+			disable_irq(irq);
+		else
+			enable_irq(irq);
+		priv->irq_masked = irq_mask;
+	}
+
+	if (priv->pps.irq > 0 && pps_mask != priv->pps.irq_masked) {
+		if (pps_mask)
+			disable_irq(priv->pps.irq);
+		else
+			enable_irq(priv->pps.irq);
+		priv->pps.irq_masked = pps_mask;
+	}
+}
+
+static int isl12020_enable_alarm(struct isl12020_data *priv, bool enable)
+{
+	unsigned int reg;
+	int err;
+
+	/*
+	 * writes are skipped by the register cache if nothing changes, the day of week is never
+	 * matched, an enable bit left over by a bootloader would hold the alarm back forever
+	 */
+	err = regmap_update_bits(priv->regmap, ISL_REG_ALARM_DWA0, ISL_BIT_ALARM_EN, 0);
+	for (reg = ISL_REG_ALARM_SCA0; reg <= ISL_REG_ALARM_MOA0 && !err; reg++)
+		err = regmap_update_bits(priv->regmap, reg, ISL_BIT_ALARM_EN,
+					 enable ? ISL_BIT_ALARM_EN : 0);
+
+	return err;
+}
+
+static int isl12020_write_alarm(struct isl12020_data *priv, struct rtc_wkalrm *alrm)
+{
+	u8 regmap_buf[ISL_REG_ALARM_DWA0 - ISL_REG_ALARM_SCA0 + 1];
+	u8 enable = alrm->enabled ? ISL_BIT_ALARM_EN : 0;
+	unsigned int sr;
+	int err;
+
+	/* a pending alarm of the previous setting is delivered and cleared before the new one */
+	err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &sr);
+	if (err < 0)
+		return err;
+	isl12020_handle_sr(priv, sr);
+
+	regmap_buf[ISL_REG_ALARM_SCA0 - ISL_REG_ALARM_SCA0] = bin2bcd(alrm->time.tm_sec) | enable;
+	regmap_buf[ISL_REG_ALARM_MNA0 - ISL_REG_ALARM_SCA0] = bin2bcd(alrm->time.tm_min) | enable;
+	regmap_buf[ISL_REG_ALARM_HRA0 - ISL_REG_ALARM_SCA0] = bin2bcd(alrm->time.tm_hour) | enable;
+	regmap_buf[ISL_REG_ALARM_DTA0 - ISL_REG_ALARM_SCA0] = bin2bcd(alrm->time.tm_mday) | enable;
+	regmap_buf[ISL_REG_ALARM_MOA0 - ISL_REG_ALARM_SCA0] = bin2bcd(alrm->time.tm_mon +
+								      MONTH_OFFSET) | enable;
+	regmap_buf[ISL_REG_ALARM_DWA0 - ISL_REG_ALARM_SCA0] = 0;
+
+	return regmap_bulk_write(priv->regmap, ISL_REG_ALARM_SCA0, regmap_buf, sizeof(regmap_buf));
+}
+
+/* hand the alarm over between the alarm registers and the 1 Hz update interrupts */
+static int isl12020_switch_alarm_mode(struct isl12020_data *priv)
+{
+	if (isl12020_uie_mode(priv))
+		return isl12020_enable_alarm(priv, false);
+
+	if (!priv->alarm.enabled)
+		return 0;
+
+	if (priv->config.freq_out_mode) {
+		dev_warn(&priv->client->dev, "frequency output active, alarm disabled\n");
+		priv->alarm.enabled = 0;
+		return 0;
+	}
+
+	return isl12020_write_alarm(priv, &priv->alarm);
+}
+
+/*
+ * the IRQ/F_OUT line is shared between alarms, update interrupts and the frequency output, the
+ * interrupt stays masked while the output switches, callers hold the rtc lock
+ */
+static int isl12020_apply_freq_out(struct isl12020_data *priv, u8 mode, bool batmode,
+				   bool *changed)
+{
+	int err;
+
+	isl12020_mask_irq(priv, true);
+	mutex_lock(&priv->lock);
+	err = isl12020_set_freq_out(priv, mode, batmode, changed);
+	mutex_unlock(&priv->lock);
+	if (!err)
+		err = isl12020_switch_alarm_mode(priv);
+	isl12020_mask_irq(priv, false);
+
+	return err;
+}
+
+static int isl12020_change_freq_out(struct isl12020_data *priv, u8 mode)
+{
+	int err;
+
+	rtc_lock(priv->rtc);
+	if (READ_ONCE(priv->calib.state) == ISL12020_CALIB_RUNNING)
+		err = -EBUSY;
+	else
+		err = isl12020_apply_freq_out(priv, mode, priv->config.freq_out_bat, NULL);
+	rtc_unlock(priv->rtc);
+
+	return err;
+}
+
+/* serve the rtc time by extrapolating the anchor, returns false if the bus has to be read */
+VISIBLE_IF_KUNIT bool isl12020_time_cache_get(struct isl12020_data *priv, struct rtc_time *tm)
+{
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	time64_t secs;
+	bool hit;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	hit = cache->interval && cache->valid &&
+	      ktime_before(now, ktime_add_ms(cache->validated,
+						   (u64)cache->interval * MSEC_PER_SEC));
+	if (hit) {
+		secs = cache->secs + div_s64(ktime_to_ns(ktime_sub(now, cache->stamp)),
+					     NSEC_PER_SEC);
+		cache->hits++;
+	} else {
+		cache->bus_reads++;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	if (hit)
+		rtc_time64_to_tm(secs, tm);
+
+	return hit;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_time_cache_get);
+
+/*
+ * the second read from the chip started somewhere between before and after, so its edge is at
+ * or before after and the next edge is behind before, every read narrows down the anchor
+ */
+VISIBLE_IF_KUNIT void isl12020_time_cache_update(struct isl12020_data *priv, struct rtc_time *tm,
+						 ktime_t before, ktime_t after)
+{
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	time64_t secs = rtc_tm_to_time64(tm);
+	unsigned long flags;
+	ktime_t edge_max;
+	ktime_t edge_min;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	if (cache->valid) {
+		edge_max = ktime_sub_ns(after, (secs - cache->secs) * NSEC_PER_SEC);
+		edge_min = ktime_sub_ns(before, (secs - cache->secs + 1) * NSEC_PER_SEC);
+
+		/* a drifting crystal or a time set behind our back invalidates the anchor */
+		if (ktime_after(cache->stamp, edge_min)) {
+			cache->stamp = ktime_add_ns(min(cache->stamp, edge_max),
+						    (secs - cache->secs) * NSEC_PER_SEC);
+			cache->secs = secs;
 		} else {
-			dev_warn(&priv->client->dev, "INT register writing failed (%d)\n", err);
+			cache->valid = false;
+		}
+	}
+	if (!cache->valid) {
+		cache->secs = secs;
+		cache->stamp = after;
+		cache->valid = true;
+	}
+	cache->validated = after;
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_time_cache_update);
+
+/* a 1 Hz edge is an exact second boundary and pins the anchor down */
+VISIBLE_IF_KUNIT void isl12020_time_cache_edge(struct isl12020_data *priv, ktime_t edge)
+{
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	s64 delta;
+
+	spin_lock(&cache->lock);
+	if (cache->valid) {
+		delta = ktime_to_ns(ktime_sub(edge, cache->stamp));
+		if (delta >= 0)
+			cache->secs += div64_u64(delta + NSEC_PER_SEC - 1, NSEC_PER_SEC);
+		else
+			cache->secs -= div64_u64(-delta, NSEC_PER_SEC);
+		cache->stamp = edge;
+	}
+	spin_unlock(&cache->lock);
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_time_cache_edge);
+
+/* edges are stamped in hard irq context, the result is applied from process context */
+static void isl12020_calib_edge(struct isl12020_data *priv, ktime_t edge)
+{
+	struct isl12020_calib *calib = &priv->calib;
+
+	spin_lock(&calib->lock);
+	if (calib->state == ISL12020_CALIB_RUNNING) {
+		if (calib->edges == CALIB_SETTLE_EDGES)
+			calib->first = edge;
+		if (calib->edges == CALIB_SETTLE_EDGES + calib->window) {
+			calib->last = edge;
+			schedule_work(&priv->calib_work);
 		}
+		calib->edges++;
+	}
+	spin_unlock(&calib->lock);
+}
+
+/* give the IRQ/F_OUT line back to whatever ran before the calibration, rtc lock held */
+static void isl12020_calib_restore(struct isl12020_data *priv, u8 freq_out_mode)
+{
+	int err;
+
+	err = isl12020_apply_freq_out(priv, freq_out_mode, priv->config.freq_out_bat, NULL);
+	if (err)
+		dev_warn(&priv->client->dev, "restoring frequency output failed (%d)\n", err);
+}
+
+/*
+ * the 1 Hz output is derived from the trimmed oscillator, comparing its edges against the
+ * (NTP/PTP disciplined) monotonic clock gives the remaining frequency error of the crystal
+ */
+static void isl12020_calib_work(struct work_struct *work)
+{
+	struct isl12020_data *priv = container_of(work, struct isl12020_data, calib_work);
+	struct isl12020_calib *calib = &priv->calib;
+	long offset = 0;
+	s64 deviation;
+	long error;
+	s64 elapsed;
+	u32 window;
+	int err;
+
+	rtc_lock(priv->rtc);
+	spin_lock_irq(&calib->lock);
+	if (calib->state != ISL12020_CALIB_RUNNING) {
+		spin_unlock_irq(&calib->lock);
+		rtc_unlock(priv->rtc);
+		return;
+	}
+	elapsed = ktime_to_ns(ktime_sub(calib->last, calib->first));
+	window = calib->window;
+	spin_unlock_irq(&calib->lock);
+
+	/* a fast rtc delivers its edges early, being off by half a period means lost edges */
+	deviation = (s64)window * NSEC_PER_SEC - elapsed;
+	error = div_s64(deviation, window);
+	if (abs(deviation) > NSEC_PER_SEC / 2) {
+		err = -EIO;
 	} else {
-		dev_warn(&priv->client->dev, "INT register reading failed (%d)\n", err);
+		mutex_lock(&priv->lock);
+		err = isl12020_get_trim(priv, &offset);
+		if (!err)
+			err = isl12020_set_trim(priv, offset - error);
+		mutex_unlock(&priv->lock);
 	}
+	isl12020_calib_restore(priv, calib->freq_out_mode);
+	rtc_unlock(priv->rtc);
+
+	spin_lock_irq(&calib->lock);
+	calib->error = error;
+	calib->state = err ? ISL12020_CALIB_FAILED : ISL12020_CALIB_DONE;
+	spin_unlock_irq(&calib->lock);
+
+	if (err)
+		dev_warn(&priv->client->dev, "calibration failed, measured %ld ppb (%d)\n", error,
+			 err);
+	else
+		dev_info(&priv->client->dev, "calibrated, measured %ld ppb, offset now %ld ppb\n",
+			 error, offset - error);
+	sysfs_notify(&priv->client->dev.kobj, NULL, "calibration");
+}
 
-	return err;
+static void isl12020_time_cache_invalidate(struct isl12020_data *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->time_cache.lock, flags);
+	priv->time_cache.valid = false;
+	spin_unlock_irqrestore(&priv->time_cache.lock, flags);
 }
 
-static int isl12020_read_temp(struct isl12020_data *priv, long *val)
+static unsigned int isl12020_temp_period(const struct isl12020_config *config)
 {
+	return config->btsr ? TEMP_PERIOD_HIGH_FREQ : TEMP_PERIOD;
+}
+
+static long isl12020_temp_from_raw(__le16 raw)
+{
+	long val = le16_to_cpu(raw);
+
+	val *= MILLI_DEGREE_CELCIUS / 2;
+	val -= CELCIUS0_M;
+
+	return val;
+}
+
+VISIBLE_IF_KUNIT int isl12020_read_temp(struct isl12020_data *priv, long *val)
+{
+	struct isl12020_temp_cache *cache = &priv->temp_cache;
+	ktime_t start = ktime_get();
 	int err = -EOPNOTSUPP;
 	__le16 buf;
 
@@ -167,15 +691,64 @@ static int isl12020_read_temp(struct isl12020_data *priv, long *val)
 	 * if BETA TSE is disabled, sensor values may be not valid -> disable temp1_input
 	 * isl12020: (ISL_REG_TEMP_TKOL<0:7> + ISL_REG_TEMP_TKOM<0:1>) / 2 - 273 (range 446 - 726)
 	 * isl12020: (ISL_REG_TEMP_TKOL<0:7> + ISL_REG_TEMP_TKOM<0:1>) / 2 - 369 (range 658 - 908)
+	 *
+	 * the chip only converts once per sensing period, so only then read again
 	 */
-	if (priv->config.tse) {
+	mutex_lock(&priv->lock);
+	if (priv->config.tse && cache->valid && time_before(jiffies, cache->expires)) {
+		*val = cache->value;
+		err = 0;
+		trace_isl12020_read_temp(&priv->client->dev, ISL_REG_TEMP_TKOL, NULL, 0, err,
+					 ktime_sub(ktime_get(), start));
+	} else if (priv->config.tse) {
 		err = regmap_bulk_read(priv->regmap, ISL_REG_TEMP_TKOL, &buf, sizeof(buf));
+		trace_isl12020_read_temp(&priv->client->dev, ISL_REG_TEMP_TKOL, (u8 *)&buf,
+					 sizeof(buf), err, ktime_sub(ktime_get(), start));
 		if (err == 0) {
-			*val = le16_to_cpu(buf);
-			*val *= MILLI_DEGREE_CELCIUS / 2;
-			*val -= CELCIUS0_M;
+			*val = isl12020_temp_from_raw(buf);
+			cache->value = *val;
+			cache->expires = jiffies +
+					 msecs_to_jiffies(isl12020_temp_period(&priv->config));
+			cache->valid = true;
 		}
 	}
+	mutex_unlock(&priv->lock);
+
+	return err;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_read_temp);
+
+static umode_t isl12020_hwmon_chip_is_visible(const struct isl12020_data *priv, u32 attr,
+					      int channel)
+{
+	return attr == hwmon_chip_update_interval ? 0644 : 0;
+}
+
+static int isl12020_hwmon_chip_read(struct isl12020_data *priv, u32 attr, int channel, long *val)
+{
+	struct isl12020_config config;
+
+	if (attr != hwmon_chip_update_interval)
+		return -EOPNOTSUPP;
+
+	isl12020_get_config(priv, &config);
+	*val = isl12020_temp_period(&config);
+
+	return 0;
+}
+
+/* only two sensing periods are supported, pick the closest one */
+static int isl12020_hwmon_chip_write(struct isl12020_data *priv, u32 attr, int channel, long val)
+{
+	int err;
+
+	if (attr != hwmon_chip_update_interval)
+		return -EOPNOTSUPP;
+
+	mutex_lock(&priv->lock);
+	err = isl12020_set_beta(priv, priv->config.tse, priv->config.btse,
+				val <= (TEMP_PERIOD_HIGH_FREQ + TEMP_PERIOD) / 2, NULL);
+	mutex_unlock(&priv->lock);
 
 	return err;
 }
@@ -228,13 +801,123 @@ static int isl12020_hwmon_temp_read(struct isl12020_data *priv, u32 attr, int ch
 	return err;
 }
 
+static umode_t isl12020_hwmon_in_is_visible(const struct isl12020_data *priv, u32 attr,
+					    int channel)
+{
+	switch (attr) {
+	case hwmon_in_min:
+	case hwmon_in_lcrit:
+		return 0644;
+	case hwmon_in_min_alarm:
+	case hwmon_in_lcrit_alarm:
+	case hwmon_in_label:
+		return 0444;
+	default:
+		return 0;
+	}
+}
+
+/* reserved field values are reported as the highest trip point */
+static int isl12020_trip_level(const int *levels, size_t len, unsigned int idx)
+{
+	return levels[min_t(size_t, idx, len - 1)];
+}
+
+static int isl12020_hwmon_in_read(struct isl12020_data *priv, u32 attr, int channel, long *val)
+{
+	u8 regs[ISL_REG_CSR_PWRBAT - ISL_REG_CSR_PWRVDD + 1];
+	struct isl12020_status status;
+	unsigned int sr;
+	u8 pwrvdd;
+	u8 pwrbat;
+	int err;
+
+	switch (attr) {
+	case hwmon_in_min:
+	case hwmon_in_lcrit:
+		/* both registers are cached, so this does not even touch the bus */
+		err = regmap_bulk_read(priv->regmap, ISL_REG_CSR_PWRVDD, regs, sizeof(regs));
+		if (err)
+			return err;
+
+		pwrvdd = regs[ISL_REG_CSR_PWRVDD - ISL_REG_CSR_PWRVDD];
+		pwrbat = regs[ISL_REG_CSR_PWRBAT - ISL_REG_CSR_PWRVDD];
+		if (channel == 0)
+			*val = isl12020_trip_level(vdd_trip_levels, ARRAY_SIZE(vdd_trip_levels),
+						   FIELD_GET(ISL_MASK_CSR_PWRVDD_TRIP, pwrvdd));
+		else if (attr == hwmon_in_min)
+			*val = isl12020_trip_level(vb85_trip_levels, ARRAY_SIZE(vb85_trip_levels),
+						   FIELD_GET(ISL_MASK_CSR_PWRBAT_VB85, pwrbat));
+		else
+			*val = isl12020_trip_level(vb75_trip_levels, ARRAY_SIZE(vb75_trip_levels),
+						   FIELD_GET(ISL_MASK_CSR_PWRBAT_VB75, pwrbat));
+		break;
+	case hwmon_in_min_alarm:
+	case hwmon_in_lcrit_alarm:
+		err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &sr);
+		if (err)
+			return err;
+
+		isl12020_handle_sr(priv, sr);
+		isl12020_get_status(priv, &status);
+		if (channel == 0)
+			*val = status.lvdd;
+		else if (attr == hwmon_in_min_alarm)
+			*val = status.lbat85;
+		else
+			*val = status.lbat75;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+/* only a few trip points are supported, pick the closest one */
+static int isl12020_hwmon_in_write(struct isl12020_data *priv, u32 attr, int channel, long val)
+{
+	unsigned int mask;
+	unsigned int reg;
+	int err;
+
+	if (channel == 0 && attr == hwmon_in_min) {
+		reg = ISL_REG_CSR_PWRVDD;
+		mask = ISL_MASK_CSR_PWRVDD_TRIP;
+		val = FIELD_PREP(ISL_MASK_CSR_PWRVDD_TRIP,
+				 find_closest(val, vdd_trip_levels, ARRAY_SIZE(vdd_trip_levels)));
+	} else if (channel == 1 && attr == hwmon_in_min) {
+		reg = ISL_REG_CSR_PWRBAT;
+		mask = ISL_MASK_CSR_PWRBAT_VB85;
+		val = FIELD_PREP(ISL_MASK_CSR_PWRBAT_VB85,
+				 find_closest(val, vb85_trip_levels, ARRAY_SIZE(vb85_trip_levels)));
+	} else if (channel == 1 && attr == hwmon_in_lcrit) {
+		reg = ISL_REG_CSR_PWRBAT;
+		mask = ISL_MASK_CSR_PWRBAT_VB75;
+		val = FIELD_PREP(ISL_MASK_CSR_PWRBAT_VB75,
+				 find_closest(val, vb75_trip_levels, ARRAY_SIZE(vb75_trip_levels)));
+	} else {
+		return -EOPNOTSUPP;
+	}
+
+	mutex_lock(&priv->lock);
+	err = regmap_update_bits(priv->regmap, reg, mask, val);
+	mutex_unlock(&priv->lock);
+
+	return err;
+}
+
 static umode_t isl12020_hwmon_ops_is_visible(const void *data, enum hwmon_sensor_types type,
 					     u32 attr, int channel)
 {
 	const struct isl12020_data *priv = data;
 
+	if (type == hwmon_chip)
+		return isl12020_hwmon_chip_is_visible(priv, attr, channel);
 	if (type == hwmon_temp)
 		return isl12020_hwmon_temp_is_visible(priv, attr, channel);
+	if (type == hwmon_in)
+		return isl12020_hwmon_in_is_visible(priv, attr, channel);
 
 	return 0;
 }
@@ -244,21 +927,56 @@ static int isl12020_hwmon_ops_read(struct device *dev, enum hwmon_sensor_types t
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
 
+	if (type == hwmon_chip)
+		return isl12020_hwmon_chip_read(priv, attr, channel, val);
 	if (type == hwmon_temp)
 		return isl12020_hwmon_temp_read(priv, attr, channel, val);
+	if (type == hwmon_in)
+		return isl12020_hwmon_in_read(priv, attr, channel, val);
 
 	return -EOPNOTSUPP;
 }
 
-static const struct hwmon_ops isl12020_hwmon_ops = {
-	.is_visible = isl12020_hwmon_ops_is_visible,
+static int isl12020_hwmon_ops_read_string(struct device *dev, enum hwmon_sensor_types type,
+					  u32 attr, int channel, const char **str)
+{
+	if (type == hwmon_in && attr == hwmon_in_label) {
+		*str = in_labels[channel];
+		return 0;
+	}
+
+	return -EOPNOTSUPP;
+}
+
+static int isl12020_hwmon_ops_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
+				    int channel, long val)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+
+	if (type == hwmon_chip)
+		return isl12020_hwmon_chip_write(priv, attr, channel, val);
+	if (type == hwmon_in)
+		return isl12020_hwmon_in_write(priv, attr, channel, val);
+
+	return -EOPNOTSUPP;
+}
+
+static const struct hwmon_ops isl12020_hwmon_ops = {
+	.is_visible = isl12020_hwmon_ops_is_visible,
 	.read = isl12020_hwmon_ops_read,
+	.read_string = isl12020_hwmon_ops_read_string,
+	.write = isl12020_hwmon_ops_write,
 };
 
 static const struct hwmon_channel_info *isl12020_info[] = {
+	HWMON_CHANNEL_INFO(chip, HWMON_C_UPDATE_INTERVAL),
 	HWMON_CHANNEL_INFO(temp,
 			   HWMON_T_INPUT | HWMON_T_LCRIT | HWMON_T_MIN | HWMON_T_MAX |
 			   HWMON_T_CRIT),
+	HWMON_CHANNEL_INFO(in,
+			   HWMON_I_MIN | HWMON_I_MIN_ALARM | HWMON_I_LABEL,
+			   HWMON_I_MIN | HWMON_I_MIN_ALARM | HWMON_I_LCRIT | HWMON_I_LCRIT_ALARM |
+			   HWMON_I_LABEL),
 	NULL,
 };
 
@@ -270,8 +988,11 @@ static const struct hwmon_chip_info isl12020_chip_info = {
 static ssize_t isl12020_oscf_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_status status;
 
-	return sysfs_emit(buf, "%c\n", priv->status.oscf ? '1' : '0');
+	isl12020_get_status(priv, &status);
+
+	return sysfs_emit(buf, "%c\n", status.oscf ? '1' : '0');
 }
 
 /* store oscillator failure for userspace checks */
@@ -286,8 +1007,11 @@ static struct device_attribute isl12020_oscf_dev_attr = {
 static ssize_t isl12020_rtcf_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_status status;
 
-	return sysfs_emit(buf, "%c\n", priv->status.rtcf ? '1' : '0');
+	isl12020_get_status(priv, &status);
+
+	return sysfs_emit(buf, "%c\n", status.rtcf ? '1' : '0');
 }
 
 /* store rtc failure for userspace checks */
@@ -302,8 +1026,11 @@ static struct device_attribute isl12020_rtcf_dev_attr = {
 static ssize_t isl12020_tse_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_config config;
 
-	return sysfs_emit(buf, "%c\n", priv->config.tse ? '1' : '0');
+	isl12020_get_config(priv, &config);
+
+	return sysfs_emit(buf, "%c\n", config.tse ? '1' : '0');
 }
 
 static ssize_t isl12020_tse_store(struct device *dev, struct device_attribute *attr,
@@ -314,8 +1041,11 @@ static ssize_t isl12020_tse_store(struct device *dev, struct device_attribute *a
 	bool val;
 
 	err = kstrtobool(buf, &val);
-	if (!err)
-		err = isl12020_set_beta(priv, val, priv->config.btse, priv->config.btsr);
+	if (!err) {
+		mutex_lock(&priv->lock);
+		err = isl12020_set_beta(priv, val, priv->config.btse, priv->config.btsr, NULL);
+		mutex_unlock(&priv->lock);
+	}
 
 	return err ? err : count;
 }
@@ -333,8 +1063,11 @@ static struct device_attribute isl12020_tse_dev_attr = {
 static ssize_t isl12020_btse_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_config config;
+
+	isl12020_get_config(priv, &config);
 
-	return sysfs_emit(buf, "%c\n", priv->config.btse ? '1' : '0');
+	return sysfs_emit(buf, "%c\n", config.btse ? '1' : '0');
 }
 
 static ssize_t isl12020_btse_store(struct device *dev, struct device_attribute *attr,
@@ -345,8 +1078,11 @@ static ssize_t isl12020_btse_store(struct device *dev, struct device_attribute *
 	bool val;
 
 	err = kstrtobool(buf, &val);
-	if (!err)
-		err = isl12020_set_beta(priv, priv->config.tse, val, priv->config.btsr);
+	if (!err) {
+		mutex_lock(&priv->lock);
+		err = isl12020_set_beta(priv, priv->config.tse, val, priv->config.btsr, NULL);
+		mutex_unlock(&priv->lock);
+	}
 
 	return err ? err : count;
 }
@@ -364,8 +1100,11 @@ static struct device_attribute isl12020_btse_dev_attr = {
 static ssize_t isl12020_btsr_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_config config;
 
-	return sysfs_emit(buf, "%c\n", priv->config.btsr ? '1' : '0');
+	isl12020_get_config(priv, &config);
+
+	return sysfs_emit(buf, "%c\n", config.btsr ? '1' : '0');
 }
 
 static ssize_t isl12020_btsr_store(struct device *dev, struct device_attribute *attr,
@@ -376,8 +1115,11 @@ static ssize_t isl12020_btsr_store(struct device *dev, struct device_attribute *
 	bool val;
 
 	err = kstrtobool(buf, &val);
-	if (!err)
-		err = isl12020_set_beta(priv, priv->config.tse, priv->config.btse, val);
+	if (!err) {
+		mutex_lock(&priv->lock);
+		err = isl12020_set_beta(priv, priv->config.tse, priv->config.btse, val, NULL);
+		mutex_unlock(&priv->lock);
+	}
 
 	return err ? err : count;
 }
@@ -396,8 +1138,11 @@ static ssize_t isl12020_bat_freq_out_show(struct device *dev, struct device_attr
 					  char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_config config;
+
+	isl12020_get_config(priv, &config);
 
-	return sysfs_emit(buf, "%c\n", priv->config.freq_out_bat ? '1' : '0');
+	return sysfs_emit(buf, "%c\n", config.freq_out_bat ? '1' : '0');
 }
 
 static ssize_t isl12020_bat_freq_out_store(struct device *dev, struct device_attribute *attr,
@@ -408,10 +1153,13 @@ static ssize_t isl12020_bat_freq_out_store(struct device *dev, struct device_att
 	bool val;
 
 	err = kstrtobool(buf, &val);
-	if (!err)
-		err = isl12020_set_freq_out(priv, priv->config.freq_out_mode, val);
+	if (!err) {
+		mutex_lock(&priv->lock);
+		err = isl12020_set_freq_out(priv, priv->config.freq_out_mode, val, NULL);
+		mutex_unlock(&priv->lock);
+	}
 
-	return err ? err : val;
+	return err ? err : count;
 }
 
 /* make battery frequency output feature runtime switchable */
@@ -427,10 +1175,12 @@ static struct device_attribute isl12020_bat_freq_out_dev_attr = {
 static ssize_t isl12020_freq_out_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_config config;
+
+	isl12020_get_config(priv, &config);
 
-	return sysfs_emit(buf, "%d (%s%s)\n", priv->config.freq_out_mode,
-			  freq_out_modes[priv->config.freq_out_mode], priv->config.freq_out_mode ?
-			  " Hz" : "");
+	return sysfs_emit(buf, "%d (%s%s)\n", config.freq_out_mode,
+			  freq_out_modes[config.freq_out_mode], config.freq_out_mode ? " Hz" : "");
 }
 
 static ssize_t isl12020_freq_out_store(struct device *dev, struct device_attribute *attr,
@@ -443,7 +1193,7 @@ static ssize_t isl12020_freq_out_store(struct device *dev, struct device_attribu
 	err = kstrtou8(buf, 10, &val);
 	if (!err) {
 		if (val <= FREQ_OUT_MODE_MAX)
-			err = isl12020_set_freq_out(priv, val, priv->config.freq_out_bat);
+			err = isl12020_change_freq_out(priv, val);
 		else
 			err = -ERANGE;
 	}
@@ -461,50 +1211,336 @@ static struct device_attribute isl12020_freq_out_dev_attr = {
 	.store = isl12020_freq_out_store,
 };
 
-static const struct attribute *isl12020_attrs[] = {
+static ssize_t isl12020_time_cache_interval_show(struct device *dev,
+						 struct device_attribute *attr, char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(priv->time_cache.interval));
+}
+
+static ssize_t isl12020_time_cache_interval_store(struct device *dev,
+						  struct device_attribute *attr, const char *buf,
+						  size_t count)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	unsigned long flags;
+	int err;
+	u32 val;
+
+	err = kstrtou32(buf, 10, &val);
+	if (!err) {
+		spin_lock_irqsave(&priv->time_cache.lock, flags);
+		priv->time_cache.interval = val;
+		spin_unlock_irqrestore(&priv->time_cache.lock, flags);
+	}
+
+	return err ? err : count;
+}
+
+/* serve time reads from a monotonic clock, revalidate against the chip after n seconds */
+static struct device_attribute isl12020_time_cache_interval_dev_attr = {
+	.attr = {
+		.name = "time_cache_interval",
+		.mode = 0644,
+	},
+	.show = isl12020_time_cache_interval_show,
+	.store = isl12020_time_cache_interval_store,
+};
+
+static ssize_t isl12020_time_cache_hits_show(struct device *dev, struct device_attribute *attr,
+					     char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 val;
+
+	spin_lock_irqsave(&priv->time_cache.lock, flags);
+	val = priv->time_cache.hits;
+	spin_unlock_irqrestore(&priv->time_cache.lock, flags);
+
+	return sysfs_emit(buf, "%llu\n", val);
+}
+
+static struct device_attribute isl12020_time_cache_hits_dev_attr = {
+	.attr = {
+		.name = "time_cache_hits",
+		.mode = 0444,
+	},
+	.show = isl12020_time_cache_hits_show,
+};
+
+static ssize_t isl12020_time_cache_bus_reads_show(struct device *dev,
+						  struct device_attribute *attr, char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 val;
+
+	spin_lock_irqsave(&priv->time_cache.lock, flags);
+	val = priv->time_cache.bus_reads;
+	spin_unlock_irqrestore(&priv->time_cache.lock, flags);
+
+	return sysfs_emit(buf, "%llu\n", val);
+}
+
+static struct device_attribute isl12020_time_cache_bus_reads_dev_attr = {
+	.attr = {
+		.name = "time_cache_bus_reads",
+		.mode = 0444,
+	},
+	.show = isl12020_time_cache_bus_reads_show,
+};
+
+static ssize_t isl12020_set_time_latency_show(struct device *dev,
+					      struct device_attribute *attr, char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(priv->set_time_latency));
+}
+
+/* measured time in ns from a set_time() call until the seconds are written */
+static struct device_attribute isl12020_set_time_latency_dev_attr = {
+	.attr = {
+		.name = "set_time_latency",
+		.mode = 0444,
+	},
+	.show = isl12020_set_time_latency_show,
+};
+
+static ssize_t isl12020_lvdd_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_status status;
+
+	isl12020_get_status(priv, &status);
+
+	return sysfs_emit(buf, "%c\n", status.lvdd ? '1' : '0');
+}
+
+/* normal power supply dropped below the PWRVDD trip point */
+static struct device_attribute isl12020_lvdd_dev_attr = {
+	.attr = {
+		.name = "vdd_low_voltage",
+		.mode = 0444,
+	},
+	.show = isl12020_lvdd_show,
+};
+
+static ssize_t isl12020_lbat85_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_status status;
+
+	isl12020_get_status(priv, &status);
+
+	return sysfs_emit(buf, "%c\n", status.lbat85 ? '1' : '0');
+}
+
+/* battery dropped below the first PWRBAT trip point (85%) */
+static struct device_attribute isl12020_lbat85_dev_attr = {
+	.attr = {
+		.name = "battery_low_voltage_85",
+		.mode = 0444,
+	},
+	.show = isl12020_lbat85_show,
+};
+
+static ssize_t isl12020_lbat75_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_status status;
+
+	isl12020_get_status(priv, &status);
+
+	return sysfs_emit(buf, "%c\n", status.lbat75 ? '1' : '0');
+}
+
+/* battery dropped below the second PWRBAT trip point (75%) */
+static struct device_attribute isl12020_lbat75_dev_attr = {
+	.attr = {
+		.name = "battery_low_voltage_75",
+		.mode = 0444,
+	},
+	.show = isl12020_lbat75_show,
+};
+
+static ssize_t isl12020_calibration_show(struct device *dev, struct device_attribute *attr,
+					 char *buf)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_calib *calib = &priv->calib;
+	enum isl12020_calib_state state;
+	u32 progress;
+	u32 window;
+	long error;
+
+	spin_lock_irq(&calib->lock);
+	state = calib->state;
+	window = calib->window;
+	progress = calib->edges > CALIB_SETTLE_EDGES ? calib->edges - CALIB_SETTLE_EDGES - 1 : 0;
+	error = calib->error;
+	spin_unlock_irq(&calib->lock);
+
+	return sysfs_emit(buf, "%s %u/%u %ld\n", calib_states[state], min(progress, window), window,
+			  error);
+}
+
+static ssize_t isl12020_calibration_store(struct device *dev, struct device_attribute *attr,
+					  const char *buf, size_t count)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	struct isl12020_calib *calib = &priv->calib;
+	bool running;
+	int err;
+	u32 val;
+
+	err = kstrtou32(buf, 10, &val);
+	if (err)
+		return err;
+	if (val && (val < CALIB_WINDOW_MIN || val > CALIB_WINDOW_MAX))
+		return -ERANGE;
+	if (priv->client->irq <= 0 || priv->irq_level)
+		return -EOPNOTSUPP;
+
+	rtc_lock(priv->rtc);
+	spin_lock_irq(&calib->lock);
+	running = calib->state == ISL12020_CALIB_RUNNING;
+	if (!val && running)
+		calib->state = ISL12020_CALIB_IDLE;
+	spin_unlock_irq(&calib->lock);
+
+	if (!val) {
+		/* abort, a pending work sees the idle state and bails out */
+		if (running)
+			isl12020_calib_restore(priv, calib->freq_out_mode);
+	} else if (running) {
+		err = -EBUSY;
+	} else {
+		calib->freq_out_mode = priv->config.freq_out_mode;
+		err = isl12020_apply_freq_out(priv, FREQ_OUT_MODE_1HZ, priv->config.freq_out_bat,
+					      NULL);
+		if (!err) {
+			spin_lock_irq(&calib->lock);
+			calib->window = val;
+			calib->edges = 0;
+			calib->error = 0;
+			calib->state = ISL12020_CALIB_RUNNING;
+			spin_unlock_irq(&calib->lock);
+		}
+	}
+	rtc_unlock(priv->rtc);
+
+	return err ? err : count;
+}
+
+/* measure the crystal against the system clock over a window of seconds, 0 aborts */
+static struct device_attribute isl12020_calibration_dev_attr = {
+	.attr = {
+		.name = "calibration",
+		.mode = 0644,
+	},
+	.show = isl12020_calibration_show,
+	.store = isl12020_calibration_store,
+};
+
+VISIBLE_IF_KUNIT const struct attribute *isl12020_attrs[] = {
 	&isl12020_oscf_dev_attr.attr,
 	&isl12020_rtcf_dev_attr.attr,
+	&isl12020_lvdd_dev_attr.attr,
+	&isl12020_lbat85_dev_attr.attr,
+	&isl12020_lbat75_dev_attr.attr,
 	&isl12020_tse_dev_attr.attr,
 	&isl12020_btse_dev_attr.attr,
 	&isl12020_btsr_dev_attr.attr,
 	&isl12020_bat_freq_out_dev_attr.attr,
 	&isl12020_freq_out_dev_attr.attr,
+	&isl12020_time_cache_interval_dev_attr.attr,
+	&isl12020_time_cache_hits_dev_attr.attr,
+	&isl12020_time_cache_bus_reads_dev_attr.attr,
+	&isl12020_set_time_latency_dev_attr.attr,
+	&isl12020_calibration_dev_attr.attr,
 	NULL,
 };
+EXPORT_SYMBOL_IF_KUNIT(isl12020_attrs);
 
-static int isl12020_rtc_ops_read_time(struct device *dev, struct rtc_time *tm)
+static void isl12020_regs_to_tm(const u8 *regs, struct rtc_time *tm)
+{
+	tm->tm_sec = bcd2bin(regs[ISL_REG_RTC_SC] & MASK7BITS);
+	tm->tm_min = bcd2bin(regs[ISL_REG_RTC_MN] & MASK7BITS);
+	tm->tm_hour = bcd2bin(regs[ISL_REG_RTC_HR] & MASK6BITS);
+	tm->tm_mday = bcd2bin(regs[ISL_REG_RTC_DT] & MASK6BITS);
+	tm->tm_mon = bcd2bin(regs[ISL_REG_RTC_MO] & MASK5BITS) - MONTH_OFFSET;
+	tm->tm_year = bcd2bin(regs[ISL_REG_RTC_YR]) + CENTURY_LEN;
+	tm->tm_wday = regs[ISL_REG_RTC_DW] & MASK3BITS;
+}
+
+VISIBLE_IF_KUNIT int isl12020_rtc_ops_read_time(struct device *dev, struct rtc_time *tm)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
 	struct regmap *regmap = priv->regmap;
-	u8 regmap_buf[ISL_REG_CSR_INT + 1];
+	u8 regmap_buf[ISL_REG_RTC_DW + 1];
+	ktime_t before = ktime_get();
+	unsigned int sc;
 	int err;
 
+	if (isl12020_time_cache_get(priv, tm)) {
+		trace_isl12020_read_time(dev, ISL_REG_RTC_SC, NULL, 0, 0,
+					 ktime_sub(ktime_get(), before));
+		return 0;
+	}
+
+	/* only volatile registers, otherwise regmap splits this into single reads */
 	err = regmap_bulk_read(regmap, ISL_REG_RTC_SC, regmap_buf, sizeof(regmap_buf));
+
+	/* single byte reads are not latched together, read again if the seconds rolled over */
+	if (!err && priv->bus_mode == ISL12020_BUS_MODE_BYTE) {
+		err = regmap_read(regmap, ISL_REG_RTC_SC, &sc);
+		if (!err && sc != regmap_buf[ISL_REG_RTC_SC])
+			err = regmap_bulk_read(regmap, ISL_REG_RTC_SC, regmap_buf,
+					       sizeof(regmap_buf));
+	}
+	trace_isl12020_read_time(dev, ISL_REG_RTC_SC, regmap_buf, sizeof(regmap_buf), err,
+				 ktime_sub(ktime_get(), before));
 	if (err < 0)
 		return err;
 
-	tm->tm_sec = bcd2bin(regmap_buf[ISL_REG_RTC_SC] & MASK7BITS);
-	tm->tm_min = bcd2bin(regmap_buf[ISL_REG_RTC_MN] & MASK7BITS);
-	tm->tm_hour = bcd2bin(regmap_buf[ISL_REG_RTC_HR] & MASK6BITS);
-	tm->tm_mday = bcd2bin(regmap_buf[ISL_REG_RTC_DT] & MASK6BITS);
-	tm->tm_mon = bcd2bin(regmap_buf[ISL_REG_RTC_MO] & MASK5BITS) - MONTH_OFFSET;
-	tm->tm_year = bcd2bin(regmap_buf[ISL_REG_RTC_YR]) + CENTURY_LEN;
-	tm->tm_wday = regmap_buf[ISL_REG_RTC_DW] & MASK3BITS;
+	isl12020_regs_to_tm(regmap_buf, tm);
+
+	isl12020_time_cache_update(priv, tm, before, ktime_get());
 
 	return 0;
 }
+EXPORT_SYMBOL_IF_KUNIT(isl12020_rtc_ops_read_time);
+
+/*
+ * the time starts counting with the write of SC and the seconds increment one second later,
+ * so the rtc core has to call set_time() one second plus the bus latency ahead of the second
+ * boundary, the latency is averaged over all calls to smooth out a busy shared bus
+ */
+static void isl12020_update_set_offset(struct isl12020_data *priv, ktime_t latency)
+{
+	u32 val = min_t(s64, ktime_to_ns(latency), NSEC_PER_SEC);
+
+	if (priv->set_time_latency)
+		val = (priv->set_time_latency * 7ULL + val) / 8;
+
+	WRITE_ONCE(priv->set_time_latency, val);
+	priv->rtc->set_offset_nsec = NSEC_PER_SEC + val;
+}
 
-static int isl12020_rtc_ops_set_time(struct device *dev, struct rtc_time *tm)
+VISIBLE_IF_KUNIT int isl12020_rtc_ops_set_time(struct device *dev, struct rtc_time *tm)
 {
 	struct isl12020_data *priv = dev_get_drvdata(dev);
 	struct regmap *regmap = priv->regmap;
 	u8 regmap_buf[ISL_REG_RTC_DW + 1];
+	ktime_t start = ktime_get();
 	int err;
 
-	err = regmap_update_bits(regmap, ISL_REG_CSR_INT, ISL_BIT_CSR_INT_WRTC,
-				 ISL_BIT_CSR_INT_WRTC);
-	if (err < 0)
-		return err;
+	isl12020_time_cache_invalidate(priv);
 
 	regmap_buf[ISL_REG_RTC_SC] = bin2bcd(tm->tm_sec);
 	regmap_buf[ISL_REG_RTC_MN] = bin2bcd(tm->tm_min);
@@ -514,122 +1550,1365 @@ static int isl12020_rtc_ops_set_time(struct device *dev, struct rtc_time *tm)
 	regmap_buf[ISL_REG_RTC_YR] = bin2bcd(tm->tm_year % CENTURY_LEN);
 	regmap_buf[ISL_REG_RTC_DW] = tm->tm_wday & MASK3BITS;
 
-	return regmap_bulk_write(priv->regmap, ISL_REG_RTC_SC, regmap_buf, sizeof(regmap_buf));
-}
+	mutex_lock(&priv->lock);
+	err = regmap_update_bits(regmap, ISL_REG_CSR_INT, ISL_BIT_CSR_INT_WRTC,
+				 ISL_BIT_CSR_INT_WRTC);
+	mutex_unlock(&priv->lock);
 
-static const struct rtc_class_ops isl12020_rtc_ops = {
-	.read_time = isl12020_rtc_ops_read_time,
-	.set_time = isl12020_rtc_ops_set_time,
-};
+	/* registers are written one by one anyway, SC first to measure when it is latched */
+	if (!err)
+		err = regmap_write(regmap, ISL_REG_RTC_SC, regmap_buf[ISL_REG_RTC_SC]);
+	if (!err) {
+		isl12020_update_set_offset(priv, ktime_sub(ktime_get(), start));
+		err = regmap_bulk_write(regmap, ISL_REG_RTC_MN, &regmap_buf[ISL_REG_RTC_MN],
+					sizeof(regmap_buf) - ISL_REG_RTC_MN);
+	}
 
-static const struct regmap_config isl12020_regmap_config = {
-	.reg_bits = 8,
-	.val_bits = 8,
-	.use_single_write = true,
-};
+	trace_isl12020_set_time(dev, ISL_REG_RTC_SC, regmap_buf, sizeof(regmap_buf), err,
+				ktime_sub(ktime_get(), start));
 
-static int isl12020_probe(struct i2c_client *client)
-{
-	struct isl12020_data *priv;
-	int initial_state;
-	int err;
-	u32 freq_out_mode = 0;
-	bool freq_out_bat = false;
+	/* a valid time clears RTCF, let the status follow right away */
+	if (!err)
+		mod_delayed_work(system_wq, &priv->status_work, 0);
 
-	if (!i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
-		return -ENODEV;
+	return err;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_rtc_ops_set_time);
 
-	priv = devm_kzalloc(&client->dev, sizeof(struct isl12020_data), GFP_KERNEL);
-	if (!priv)
-		return -ENOMEM;
+static int isl12020_rtc_ops_read_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	u8 regmap_buf[ISL_REG_ALARM_MOA0 - ISL_REG_ALARM_SCA0 + 1];
+	unsigned int status;
+	int err;
 
-	priv->client = client;
-	dev_set_drvdata(&client->dev, priv);
+	if (isl12020_uie_mode(priv)) {
+		*alrm = priv->alarm;
+		return 0;
+	}
 
-	priv->regmap = devm_regmap_init_i2c(client, &isl12020_regmap_config);
-	if (IS_ERR(priv->regmap)) {
-		err = PTR_ERR(priv->regmap);
-		dev_err(&client->dev, "allocating regmap failed (%d)\n", err);
+	/* the alarm registers are cached, only the status register hits the bus */
+	err = regmap_bulk_read(priv->regmap, ISL_REG_ALARM_SCA0, regmap_buf, sizeof(regmap_buf));
+	if (err < 0)
 		return err;
-	}
 
-	priv->rtc = devm_rtc_allocate_device(&client->dev);
-	if (IS_ERR(priv->rtc)) {
-		err = PTR_ERR(priv->rtc);
-		dev_err(&client->dev, "allocating rtc device failed (%d)\n", err);
+	err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &status);
+	if (err < 0)
 		return err;
-	}
+	isl12020_handle_sr(priv, status);
+
+	alrm->time.tm_sec = bcd2bin(regmap_buf[ISL_REG_ALARM_SCA0 - ISL_REG_ALARM_SCA0] &
+				    MASK7BITS);
+	alrm->time.tm_min = bcd2bin(regmap_buf[ISL_REG_ALARM_MNA0 - ISL_REG_ALARM_SCA0] &
+				    MASK7BITS);
+	alrm->time.tm_hour = bcd2bin(regmap_buf[ISL_REG_ALARM_HRA0 - ISL_REG_ALARM_SCA0] &
+				     MASK6BITS);
+	alrm->time.tm_mday = bcd2bin(regmap_buf[ISL_REG_ALARM_DTA0 - ISL_REG_ALARM_SCA0] &
+				     MASK6BITS);
+	alrm->time.tm_mon = bcd2bin(regmap_buf[ISL_REG_ALARM_MOA0 - ISL_REG_ALARM_SCA0] &
+				    MASK5BITS) - MONTH_OFFSET;
+
+	alrm->enabled = !!(regmap_buf[0] & ISL_BIT_ALARM_EN);
+	alrm->pending = alrm->enabled && (status & ISL_BIT_CSR_SR_ALM);
 
-	priv->rtc->ops = &isl12020_rtc_ops;
-	priv->rtc->range_min = RTC_TIMESTAMP_BEGIN_2000;
-	priv->rtc->range_max = RTC_TIMESTAMP_END_2099;
+	return 0;
+}
 
-	/* sysfs is required and should not fail */
-	err = sysfs_create_files(&client->dev.kobj, isl12020_attrs);
-	if (err) {
-		pr_err("failed to create sysfs entries (%d)\n", err);
-		goto sysfs_fail;
-	}
+static int isl12020_rtc_ops_alarm_irq_enable(struct device *dev, unsigned int enabled)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
 
-	/* get initial state of the rtc and check for failures, this is critical */
-	err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &initial_state);
-	if (err) {
-		dev_err(&client->dev, "failed to acquire initial status (%d)\n", err);
-		goto state_fail;
-	}
-	if (initial_state & ISL_BIT_CSR_SR_OSCF) {
-		priv->status.oscf = true;
-		dev_warn(&client->dev, "oscillator failure detected\n");
-	}
-	if (initial_state & ISL_BIT_CSR_SR_RTCF) {
-		priv->status.rtcf = true;
-		dev_warn(&client->dev, "RTC power failure detected\n");
+	if (isl12020_uie_mode(priv)) {
+		priv->alarm.enabled = enabled;
+		return 0;
 	}
 
-	/* setup of hwmon failing is not critical */
-	priv->hwmon_dev = hwmon_device_register_with_info(&client->dev, INTERNAL_NAME, priv,
-							  &isl12020_chip_info, NULL);
-	if (IS_ERR(priv->hwmon_dev)) {
-		dev_warn(&client->dev, "registering hwmon device failed (%ld)\n",
-			 PTR_ERR(priv->hwmon_dev));
-	}
+	/* the IRQ/F_OUT pin only signals alarms while the frequency output is off */
+	if (enabled && priv->config.freq_out_mode)
+		return -EBUSY;
 
-	if (device_property_present(&client->dev, "temperature-sensor-enable"))
-		isl12020_set_beta(priv, true, priv->config.btse, priv->config.btsr);
-	if (device_property_present(&client->dev, "battery-temperature-sensor-enable"))
-		isl12020_set_beta(priv, priv->config.tse, true, priv->config.btsr);
-	if (device_property_present(&client->dev, "high-sensing-frequency-enable"))
-		isl12020_set_beta(priv, priv->config.tse, priv->config.btse, true);
+	priv->alarm.enabled = enabled;
 
-	/*
-	 * failure of setting the frequency output support is not critical
-	 * set frequency output to disabled in battery and normal mode by default
-	 * which enables alarm signal support (an internal hardware switch)
-	 */
-	if (device_property_present(&client->dev, "battery-frequency-output-enable"))
-		freq_out_bat = true;
-	device_property_read_u32(&client->dev, "frequency-output-mode", &freq_out_mode);
-	err = isl12020_set_freq_out(priv, freq_out_mode, freq_out_bat);
-	if (err) {
-		dev_warn(&client->dev,
-			 "setting frequency output failed (battery mode=%d, mode=%d, err=%d)\n",
-			 freq_out_bat, freq_out_mode, err);
-	}
+	return isl12020_enable_alarm(priv, enabled);
+}
+
+static int isl12020_rtc_ops_set_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
 
-	return devm_rtc_register_device(priv->rtc);
+	if (!isl12020_uie_mode(priv) && alrm->enabled && priv->config.freq_out_mode)
+		return -EBUSY;
 
-state_fail:
-	sysfs_remove_files(&client->dev.kobj, isl12020_attrs);
-sysfs_fail:
-	return err;
+	priv->alarm = *alrm;
+	priv->alarm.pending = 0;
+	if (isl12020_uie_mode(priv))
+		return 0;
+
+	return isl12020_write_alarm(priv, alrm);
 }
 
+/* ITRO is part of the register cache, reading the offset never touches the bus */
+static int isl12020_rtc_ops_read_offset(struct device *dev, long *offset)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+
+	return isl12020_get_trim(priv, offset);
+}
+
+static int isl12020_rtc_ops_set_offset(struct device *dev, long offset)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	int err;
+
+	mutex_lock(&priv->lock);
+	err = isl12020_set_trim(priv, offset);
+	mutex_unlock(&priv->lock);
+
+	return err;
+}
+
+/* RESEALB disconnects the battery until VDD comes back, the shipping mode of the chip */
+static int isl12020_rtc_ops_param_get(struct device *dev, struct rtc_param *param)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	unsigned int pwrbat;
+	int err;
+
+	switch (param->param) {
+	case RTC_PARAM_BACKUP_SWITCH_MODE:
+		/* PWRBAT is part of the register cache, this does not touch the bus */
+		err = regmap_read(priv->regmap, ISL_REG_CSR_PWRBAT, &pwrbat);
+		if (err)
+			return err;
+
+		param->uvalue = pwrbat & ISL_BIT_CSR_PWRBAT_RESEALB ? RTC_BSM_STANDBY :
+								      RTC_BSM_DIRECT;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int isl12020_rtc_ops_param_set(struct device *dev, struct rtc_param *param)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int err;
+
+	switch (param->param) {
+	case RTC_PARAM_BACKUP_SWITCH_MODE:
+		if (param->uvalue == RTC_BSM_DIRECT)
+			val = 0;
+		else if (param->uvalue == RTC_BSM_STANDBY)
+			val = ISL_BIT_CSR_PWRBAT_RESEALB;
+		else
+			return -EINVAL;
+
+		mutex_lock(&priv->lock);
+		err = regmap_update_bits(priv->regmap, ISL_REG_CSR_PWRBAT,
+					 ISL_BIT_CSR_PWRBAT_RESEALB, val);
+		mutex_unlock(&priv->lock);
+		if (err)
+			dev_warn(dev, "PWRBAT register update failed (%d)\n", err);
+		return err;
+	default:
+		return -EINVAL;
+	}
+}
+
+static const struct rtc_class_ops isl12020_rtc_ops = {
+	.read_time = isl12020_rtc_ops_read_time,
+	.set_time = isl12020_rtc_ops_set_time,
+	.read_alarm = isl12020_rtc_ops_read_alarm,
+	.set_alarm = isl12020_rtc_ops_set_alarm,
+	.alarm_irq_enable = isl12020_rtc_ops_alarm_irq_enable,
+	.read_offset = isl12020_rtc_ops_read_offset,
+	.set_offset = isl12020_rtc_ops_set_offset,
+	.param_get = isl12020_rtc_ops_param_get,
+	.param_set = isl12020_rtc_ops_param_set,
+};
+
+/* the period deviation also contains the remaining frequency error of the crystal */
+static void isl12020_pps_edge(struct isl12020_data *priv, ktime_t edge, struct pps_event_time *ts)
+{
+	struct pps_device *pps_dev = READ_ONCE(priv->pps.dev);
+	struct isl12020_pps *pps = &priv->pps;
+	s64 period;
+	u64 jitter;
+
+	if (!IS_ENABLED(CONFIG_PPS) || !pps_dev)
+		return;
+
+	pps_event(pps_dev, ts, PPS_CAPTUREASSERT, NULL);
+
+	spin_lock(&pps->lock);
+	if (pps->edges) {
+		period = ktime_to_ns(ktime_sub(edge, pps->last));
+		if (period > NSEC_PER_SEC + NSEC_PER_SEC / 2) {
+			pps->missed += div_u64(period + NSEC_PER_SEC / 2, NSEC_PER_SEC) - 1;
+		} else {
+			jitter = abs(period - (s64)NSEC_PER_SEC);
+			pps->jitter_last = jitter;
+			pps->jitter_avg = pps->jitter_avg - pps->jitter_avg / 8 + jitter / 8;
+			pps->jitter_max = max(pps->jitter_max, jitter);
+		}
+	}
+	pps->last = edge;
+	pps->edges++;
+	spin_unlock(&pps->lock);
+}
+
+/*
+ * the rtc core keeps its alarm and update timers in the software alarm, only an edge reaching
+ * it is worth waking up the core, which reads the time and holds a wakeup event every time,
+ * without a time cache anchor every edge of an armed alarm is passed on
+ */
+static bool isl12020_alarm_due(struct isl12020_data *priv)
+{
+	struct isl12020_time_cache *cache = &priv->time_cache;
+	bool due;
+
+	if (!READ_ONCE(priv->alarm.enabled))
+		return false;
+
+	spin_lock(&cache->lock);
+	due = !cache->valid || cache->secs >= rtc_tm_to_time64(&priv->alarm.time);
+	spin_unlock(&cache->lock);
+
+	return due;
+}
+
+/* the 1 Hz edges need no bus access and are forwarded straight from hard irq context */
+static irqreturn_t isl12020_irq(int irq, void *data)
+{
+	struct isl12020_data *priv = data;
+	struct pps_event_time ts;
+	ktime_t edge;
+
+	/* stamp first, everything before adds jitter */
+	pps_get_ts(&ts);
+	edge = ktime_get();
+
+	if (!isl12020_uie_mode(priv))
+		return IRQ_WAKE_THREAD;
+
+	if (!priv->pps.gpio)
+		isl12020_pps_edge(priv, edge, &ts);
+	isl12020_time_cache_edge(priv, edge);
+	isl12020_calib_edge(priv, edge);
+	if (isl12020_alarm_due(priv))
+		rtc_update_irq(priv->rtc, 1, RTC_IRQF | RTC_UF);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * a separate pps line only carries the 1 Hz edges, the IRQ/F_OUT interrupt stays as it is, the
+ * line is masked while the frequency output runs at any other rate
+ */
+static irqreturn_t isl12020_pps_irq(int irq, void *data)
+{
+	struct isl12020_data *priv = data;
+	struct pps_event_time ts;
+	ktime_t edge;
+
+	pps_get_ts(&ts);
+	edge = ktime_get();
+
+	isl12020_pps_edge(priv, edge, &ts);
+
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t isl12020_irq_handler(int irq, void *data)
+{
+	struct isl12020_data *priv = data;
+	unsigned int status;
+	int err;
+
+	err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &status);
+	if (err < 0)
+		return IRQ_NONE;
+
+	return isl12020_handle_sr(priv, status) ? IRQ_HANDLED : IRQ_NONE;
+}
+
+static enum isl12020_bus_path isl12020_bus_path(struct isl12020_data *priv, u8 reg, bool write)
+{
+	if (priv->bus_stats.probing)
+		return ISL12020_BUS_PROBE;
+
+	switch (reg) {
+	case ISL_REG_RTC_SC ... ISL_REG_RTC_DW:
+		return write ? ISL12020_BUS_SET_TIME : ISL12020_BUS_READ_TIME;
+	case ISL_REG_CSR_SR:
+	case ISL_REG_ALARM_SCA0 ... ISL_REG_ALARM_DWA0:
+		return ISL12020_BUS_ALARM;
+	case ISL_REG_TEMP_TKOL:
+	case ISL_REG_TEMP_TKOM:
+		return ISL12020_BUS_TEMP;
+	case ISL_REG_USR_START ... ISL_REG_USR_END:
+		return ISL12020_BUS_NVMEM;
+	default:
+		return ISL12020_BUS_CONFIG;
+	}
+}
+
+static void isl12020_bus_account(struct isl12020_data *priv, enum isl12020_bus_path path,
+				 size_t len, unsigned int retries, ktime_t start, int err)
+{
+	struct isl12020_bus_stats *stats = &priv->bus_stats;
+	struct isl12020_bus_counters *counters;
+	s64 us = ktime_us_delta(ktime_get(), start);
+	unsigned int bucket = min_t(unsigned int, fls64(max_t(s64, us, 0)), BUS_HIST_BUCKETS - 1);
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	counters = &stats->path[path];
+	counters->transfers++;
+	counters->retries += retries;
+	if (err)
+		counters->errors++;
+	else
+		counters->bytes += len;
+	stats->latency[bucket]++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/*
+ * smbus adapters move at most a block per transfer, plain i2c is only limited by the adapter
+ * quirks, which also apply to emulated block transfers, a write spends one byte on the register
+ * address
+ */
+static size_t isl12020_bus_max_len(struct isl12020_data *priv, bool write)
+{
+	const struct i2c_adapter_quirks *quirks = priv->client->adapter->quirks;
+	size_t len;
+
+	switch (priv->bus_mode) {
+	case ISL12020_BUS_MODE_I2C:
+		len = SIZE_MAX;
+		break;
+	case ISL12020_BUS_MODE_BLOCK:
+		len = I2C_SMBUS_BLOCK_MAX;
+		break;
+	default:
+		return 1;
+	}
+
+	if (!quirks)
+		return len;
+
+	if (write && quirks->max_write_len)
+		len = min_t(size_t, len, quirks->max_write_len - 1);
+	if (!write && quirks->max_read_len)
+		len = min_t(size_t, len, quirks->max_read_len);
+	if (!write && quirks->max_comb_2nd_msg_len)
+		len = min_t(size_t, len, quirks->max_comb_2nd_msg_len);
+
+	return max_t(size_t, len, 1);
+}
+
+/* register address write and data read in one combined transfer */
+static int isl12020_bus_read_once(struct isl12020_data *priv, u8 reg, u8 *val, size_t len)
+{
+	struct i2c_client *client = priv->client;
+	struct i2c_msg msgs[] = {
+		{ .addr = client->addr, .len = sizeof(reg), .buf = &reg },
+		{ .addr = client->addr, .flags = I2C_M_RD, .len = len, .buf = val },
+	};
+	int err;
+
+	switch (priv->bus_mode) {
+	case ISL12020_BUS_MODE_I2C:
+		err = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
+		if (err >= 0)
+			err = err == ARRAY_SIZE(msgs) ? 0 : -EIO;
+		break;
+	case ISL12020_BUS_MODE_BLOCK:
+		err = i2c_smbus_read_i2c_block_data(client, reg, len, val);
+		if (err >= 0)
+			err = (size_t)err == len ? 0 : -EIO;
+		break;
+	default:
+		err = i2c_smbus_read_byte_data(client, reg);
+		if (err >= 0) {
+			*val = err;
+			err = 0;
+		}
+		break;
+	}
+
+	return err;
+}
+
+/*
+ * every transfer is retried and accounted on its own, either on the given path or with
+ * ISL12020_BUS_PATHS on the one of the register range it targets
+ */
+static int isl12020_bus_read_path(struct isl12020_data *priv, enum isl12020_bus_path path,
+				  u8 reg, void *val, size_t len)
+{
+	size_t max = isl12020_bus_max_len(priv, false);
+	unsigned int retries;
+	ktime_t start;
+	size_t chunk;
+	int err;
+
+	for (; len; reg += chunk, val += chunk, len -= chunk) {
+		chunk = min(len, max);
+		start = ktime_get();
+		for (retries = 0; ; retries++) {
+			err = isl12020_bus_read_once(priv, reg, val, chunk);
+			if (err != -EAGAIN || retries == BUS_RETRIES)
+				break;
+		}
+
+		isl12020_bus_account(priv, path == ISL12020_BUS_PATHS ?
+				     isl12020_bus_path(priv, reg, false) : path,
+				     sizeof(reg) + chunk, retries, start, err);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int isl12020_bus_read(struct isl12020_data *priv, u8 reg, void *val, size_t len)
+{
+	return isl12020_bus_read_path(priv, ISL12020_BUS_PATHS, reg, val, len);
+}
+
+/* data starts with the register address */
+static int isl12020_bus_write_once(struct isl12020_data *priv, const u8 *data, size_t len)
+{
+	struct i2c_client *client = priv->client;
+	int err;
+
+	switch (priv->bus_mode) {
+	case ISL12020_BUS_MODE_I2C:
+		err = i2c_master_send(client, data, len);
+		if (err >= 0)
+			err = (size_t)err == len ? 0 : -EIO;
+		return err;
+	case ISL12020_BUS_MODE_BLOCK:
+		return i2c_smbus_write_i2c_block_data(client, data[0], len - 1, &data[1]);
+	default:
+		return i2c_smbus_write_byte_data(client, data[0], data[1]);
+	}
+}
+
+/*
+ * data starts with the register address, chunks get their own address prefix, the largest
+ * write is a whole user sram
+ */
+static int isl12020_bus_write(struct isl12020_data *priv, const u8 *data, size_t len)
+{
+	size_t max = isl12020_bus_max_len(priv, true);
+	u8 buf[ISL_USR_LEN + 1];
+	unsigned int retries;
+	const u8 *msg;
+	size_t offset;
+	ktime_t start;
+	size_t chunk;
+	int err;
+
+	for (offset = 0; offset < len - 1; offset += chunk) {
+		chunk = min(len - 1 - offset, max);
+		if (chunk == len - 1) {
+			msg = data;
+		} else {
+			buf[0] = data[0] + offset;
+			memcpy(&buf[1], &data[1 + offset], chunk);
+			msg = buf;
+		}
+
+		start = ktime_get();
+		for (retries = 0; ; retries++) {
+			err = isl12020_bus_write_once(priv, msg, chunk + 1);
+			if (err != -EAGAIN || retries == BUS_RETRIES)
+				break;
+		}
+
+		isl12020_bus_account(priv, isl12020_bus_path(priv, msg[0], true), chunk + 1,
+				     retries, start, err);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int isl12020_regmap_bus_read(void *context, const void *reg, size_t reg_size, void *val,
+				    size_t val_size)
+{
+	return isl12020_bus_read(context, *(const u8 *)reg, val, val_size);
+}
+
+static int isl12020_regmap_bus_write(void *context, const void *data, size_t count)
+{
+	return isl12020_bus_write(context, data, count);
+}
+
+/* a plain i2c regmap bus with accounting of every transfer */
+static const struct regmap_bus isl12020_regmap_bus = {
+	.read = isl12020_regmap_bus_read,
+	.write = isl12020_regmap_bus_write,
+};
+
+/* the bus helpers split the transfers as the adapter requires */
+VISIBLE_IF_KUNIT int isl12020_nvmem_read(void *context, unsigned int offset, void *val,
+					 size_t bytes)
+{
+	return isl12020_bus_read(context, ISL_REG_USR_START + offset, val, bytes);
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_nvmem_read);
+
+VISIBLE_IF_KUNIT int isl12020_nvmem_write(void *context, unsigned int offset, void *val,
+					  size_t bytes)
+{
+	u8 buf[ISL_USR_LEN + 1];
+
+	buf[0] = ISL_REG_USR_START + offset;
+	memcpy(&buf[1], val, bytes);
+
+	return isl12020_bus_write(context, buf, bytes + 1);
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_nvmem_write);
+
+static int isl12020_debugfs_bus_show(struct seq_file *s, void *data)
+{
+	struct isl12020_data *priv = s->private;
+	struct isl12020_bus_counters path[ISL12020_BUS_PATHS];
+	u64 latency[BUS_HIST_BUCKETS];
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&priv->bus_stats.lock, flags);
+	memcpy(path, priv->bus_stats.path, sizeof(path));
+	memcpy(latency, priv->bus_stats.latency, sizeof(latency));
+	spin_unlock_irqrestore(&priv->bus_stats.lock, flags);
+
+	seq_printf(s, "mode %s\n\n", bus_mode_names[priv->bus_mode]);
+	seq_printf(s, "%-12s %12s %12s %8s %8s\n", "path", "transfers", "bytes", "errors",
+		   "retries");
+	for (i = 0; i < ISL12020_BUS_PATHS; i++)
+		seq_printf(s, "%-12s %12llu %12llu %8llu %8llu\n", bus_path_names[i],
+			   path[i].transfers, path[i].bytes, path[i].errors, path[i].retries);
+
+	seq_puts(s, "\ntransfer time\n");
+	for (i = 0; i < BUS_HIST_BUCKETS - 1; i++)
+		seq_printf(s, " < %6lu us %12llu\n", BIT(i), latency[i]);
+	seq_printf(s, ">= %6lu us %12llu\n", BIT(i - 1), latency[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(isl12020_debugfs_bus);
+
+/*
+ * the time stamps have no year, take the latest one not after now, an all zero time stamp
+ * means there was no switch since the last clearing and returns false
+ */
+VISIBLE_IF_KUNIT bool isl12020_timestamp_to_tm(const u8 *regs, time64_t now, struct rtc_time *tm)
+{
+	struct rtc_time now_tm;
+
+	if (!memchr_inv(regs, 0, ISL_REG_TSV2B_VMO - ISL_REG_TSV2B_VSC + 1))
+		return false;
+
+	rtc_time64_to_tm(now, &now_tm);
+	*tm = (struct rtc_time){
+		.tm_sec = bcd2bin(regs[0] & MASK7BITS),
+		.tm_min = bcd2bin(regs[1] & MASK7BITS),
+		.tm_hour = bcd2bin(regs[2] & MASK6BITS),
+		.tm_mday = bcd2bin(regs[3] & MASK6BITS),
+		.tm_mon = bcd2bin(regs[4] & MASK5BITS) - MONTH_OFFSET,
+		.tm_year = now_tm.tm_year,
+	};
+	if (rtc_tm_to_time64(tm) > now)
+		tm->tm_year--;
+
+	return true;
+}
+EXPORT_SYMBOL_IF_KUNIT(isl12020_timestamp_to_tm);
+
+static void isl12020_print_timestamp(struct seq_file *s, const char *name, const u8 *regs)
+{
+	struct rtc_time tm;
+
+	if (isl12020_timestamp_to_tm(regs, ktime_get_real_seconds(), &tm))
+		seq_printf(s, "%-16s %ptRs\n", name, &tm);
+	else
+		seq_printf(s, "%-16s none\n", name);
+}
+
+/* both time stamps in one bulk read */
+static int isl12020_debugfs_power_switch_show(struct seq_file *s, void *data)
+{
+	struct isl12020_data *priv = s->private;
+	u8 regs[ISL_REG_TSB2V_BMO - ISL_REG_TSV2B_VSC + 1];
+	int err;
+
+	err = regmap_bulk_read(priv->regmap, ISL_REG_TSV2B_VSC, regs, sizeof(regs));
+	if (err)
+		return err;
+
+	isl12020_print_timestamp(s, "vdd_to_battery", regs);
+	isl12020_print_timestamp(s, "battery_to_vdd", &regs[ISL_REG_TSB2V_BSC - ISL_REG_TSV2B_VSC]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(isl12020_debugfs_power_switch);
+
+static int isl12020_debugfs_events_show(struct seq_file *s, void *data)
+{
+	struct isl12020_data *priv = s->private;
+	struct isl12020_event *event;
+	struct rtc_time tm;
+	unsigned int i;
+
+	mutex_lock(&priv->lock);
+	for (i = 0; i < priv->events_count; i++) {
+		event = &priv->events[(priv->events_head + STATUS_EVENTS - priv->events_count + i) %
+				      STATUS_EVENTS];
+		rtc_time64_to_tm(event->time, &tm);
+		seq_printf(s, "%ptRs %s\n", &tm, event_names[event->category]);
+	}
+	mutex_unlock(&priv->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(isl12020_debugfs_events);
+
+static int isl12020_debugfs_pps_show(struct seq_file *s, void *data)
+{
+	struct isl12020_data *priv = s->private;
+	struct isl12020_pps *pps = &priv->pps;
+	u64 jitter_last;
+	u64 jitter_avg;
+	u64 jitter_max;
+	unsigned long flags;
+	u64 missed;
+	u64 edges;
+
+	spin_lock_irqsave(&pps->lock, flags);
+	edges = pps->edges;
+	missed = pps->missed;
+	jitter_last = pps->jitter_last;
+	jitter_avg = pps->jitter_avg;
+	jitter_max = pps->jitter_max;
+	spin_unlock_irqrestore(&pps->lock, flags);
+
+	seq_printf(s, "edges %llu\nmissed %llu\n", edges, missed);
+	seq_printf(s, "jitter last %llu ns\njitter avg %llu ns\njitter max %llu ns\n",
+		   jitter_last, jitter_avg, jitter_max);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(isl12020_debugfs_pps);
+
+static void isl12020_debugfs_remove(void *data)
+{
+	debugfs_remove_recursive(data);
+}
+
+/* the edge handlers may still look at the source until it is hidden and synchronized */
+static void isl12020_pps_remove(void *data)
+{
+	struct isl12020_data *priv = data;
+	struct pps_device *pps_dev = priv->pps.dev;
+
+	WRITE_ONCE(priv->pps.dev, NULL);
+	if (priv->pps.irq > 0)
+		synchronize_irq(priv->pps.irq);
+	else
+		synchronize_irq(priv->client->irq);
+	pps_unregister_source(pps_dev);
+}
+
+static int isl12020_clk_prepare(struct clk_hw *hw)
+{
+	struct isl12020_data *priv = container_of(hw, struct isl12020_data, clk_hw);
+
+	return isl12020_change_freq_out(priv, priv->clk_mode);
+}
+
+static void isl12020_clk_unprepare(struct clk_hw *hw)
+{
+	struct isl12020_data *priv = container_of(hw, struct isl12020_data, clk_hw);
+
+	isl12020_change_freq_out(priv, 0);
+}
+
+/* the output mode may also change through sysfs, the config snapshot is always current */
+static int isl12020_clk_is_prepared(struct clk_hw *hw)
+{
+	struct isl12020_data *priv = container_of(hw, struct isl12020_data, clk_hw);
+	struct isl12020_config config;
+
+	isl12020_get_config(priv, &config);
+
+	return config.freq_out_mode && config.freq_out_mode < ARRAY_SIZE(freq_out_rates);
+}
+
+static unsigned long isl12020_clk_recalc_rate(struct clk_hw *hw, unsigned long parent_rate)
+{
+	struct isl12020_data *priv = container_of(hw, struct isl12020_data, clk_hw);
+	struct isl12020_config config;
+
+	isl12020_get_config(priv, &config);
+	if (config.freq_out_mode && config.freq_out_mode < ARRAY_SIZE(freq_out_rates))
+		return freq_out_rates[config.freq_out_mode];
+
+	return freq_out_rates[priv->clk_mode];
+}
+
+static u8 isl12020_clk_closest_mode(unsigned long rate)
+{
+	u8 best = 1;
+	u8 mode;
+
+	for (mode = 2; mode < ARRAY_SIZE(freq_out_rates); mode++)
+		if (abs_diff(freq_out_rates[mode], rate) < abs_diff(freq_out_rates[best], rate))
+			best = mode;
+
+	return best;
+}
+
+static int isl12020_clk_determine_rate(struct clk_hw *hw, struct clk_rate_request *req)
+{
+	req->rate = freq_out_rates[isl12020_clk_closest_mode(req->rate)];
+
+	return 0;
+}
+
+/* a running output switches right away, otherwise the rate is used on the next prepare */
+static int isl12020_clk_set_rate(struct clk_hw *hw, unsigned long rate, unsigned long parent_rate)
+{
+	struct isl12020_data *priv = container_of(hw, struct isl12020_data, clk_hw);
+	u8 mode = isl12020_clk_closest_mode(rate);
+
+	priv->clk_mode = mode;
+	if (!isl12020_clk_is_prepared(hw))
+		return 0;
+
+	return isl12020_change_freq_out(priv, mode);
+}
+
+static const struct clk_ops isl12020_clk_ops = {
+	.prepare = isl12020_clk_prepare,
+	.unprepare = isl12020_clk_unprepare,
+	.is_prepared = isl12020_clk_is_prepared,
+	.recalc_rate = isl12020_clk_recalc_rate,
+	.determine_rate = isl12020_clk_determine_rate,
+	.set_rate = isl12020_clk_set_rate,
+};
+
+/* the F_OUT pin is only offered as clock if the firmware asks for it with "#clock-cells" */
+static int isl12020_clk_init(struct isl12020_data *priv)
+{
+	struct device *dev = &priv->client->dev;
+	/* an output configured by sysfs or "frequency-output-mode" must survive unused clocks */
+	struct clk_init_data init = {
+		.ops = &isl12020_clk_ops,
+		.flags = CLK_GET_RATE_NOCACHE | CLK_IGNORE_UNUSED,
+	};
+	struct isl12020_config config;
+	int err;
+
+	if (!device_property_present(dev, "#clock-cells"))
+		return 0;
+
+	if (device_property_read_string(dev, "clock-output-names", &init.name))
+		init.name = devm_kasprintf(dev, GFP_KERNEL, "%s-fout", dev_name(dev));
+	if (!init.name)
+		return -ENOMEM;
+
+	isl12020_get_config(priv, &config);
+	priv->clk_mode = config.freq_out_mode && config.freq_out_mode < ARRAY_SIZE(freq_out_rates) ?
+			 config.freq_out_mode : 1;
+	priv->clk_hw.init = &init;
+
+	err = devm_clk_hw_register(dev, &priv->clk_hw);
+	if (err)
+		return err;
+
+	return devm_of_clk_add_hw_provider(dev, of_clk_hw_simple_get, &priv->clk_hw);
+}
+
+/*
+ * a pps source is optional, either on a separate "pps-gpios" line or with "pps-source" on
+ * the IRQ/F_OUT interrupt, both only deliver edges while the frequency output runs at 1 Hz
+ */
+static int isl12020_pps_init(struct isl12020_data *priv)
+{
+	struct device *dev = &priv->client->dev;
+	struct pps_source_info info = {
+		.name = DRIVER_NAME,
+		.mode = PPS_CAPTUREASSERT | PPS_OFFSETASSERT | PPS_CANWAIT | PPS_TSFMT_TSPEC,
+		.owner = THIS_MODULE,
+		.dev = dev,
+	};
+	struct pps_device *pps_dev;
+	int irq = 0;
+	int err;
+
+	if (!IS_ENABLED(CONFIG_PPS))
+		return 0;
+
+	priv->pps.gpio = devm_gpiod_get_optional(dev, "pps", GPIOD_IN);
+	if (IS_ERR(priv->pps.gpio))
+		return PTR_ERR(priv->pps.gpio);
+
+	if (priv->pps.gpio) {
+		irq = gpiod_to_irq(priv->pps.gpio);
+		if (irq < 0)
+			return irq;
+	} else if (!device_property_read_bool(dev, "pps-source")) {
+		return 0;
+	} else if (priv->client->irq <= 0) {
+		return -ENXIO;
+	} else if (priv->irq_level) {
+		return -EINVAL;
+	}
+
+	/* edges are dropped until the source is registered, the line is only enabled at 1 Hz */
+	if (irq > 0) {
+		priv->pps.irq_masked = true;
+		err = devm_request_irq(dev, irq, isl12020_pps_irq,
+				       IRQF_TRIGGER_RISING | IRQF_NO_AUTOEN, DRIVER_NAME "-pps",
+				       priv);
+		if (err)
+			return err;
+		priv->pps.irq = irq;
+	}
+
+	pps_dev = pps_register_source(&info, PPS_CAPTUREASSERT | PPS_OFFSETASSERT);
+	if (IS_ERR(pps_dev))
+		return PTR_ERR(pps_dev);
+
+	WRITE_ONCE(priv->pps.dev, pps_dev);
+	err = devm_add_action_or_reset(dev, isl12020_pps_remove, priv);
+	if (err)
+		return err;
+
+	rtc_lock(priv->rtc);
+	isl12020_mask_irq(priv, false);
+	rtc_unlock(priv->rtc);
+
+	if (priv->config.freq_out_mode != FREQ_OUT_MODE_1HZ)
+		dev_info(dev, "pps source waits for a 1 Hz frequency output\n");
+
+	return 0;
+}
+
+/*
+ * one bulk read of the whole register file, bypassing the caches for a coherent view, SR is
+ * part of it and gets handled like an interrupt would
+ */
+static ssize_t isl12020_snapshot_read(struct file *filp, struct kobject *kobj,
+				      const struct bin_attribute *attr, char *buf, loff_t off,
+				      size_t count)
+{
+	struct isl12020_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	struct isl12020_snapshot snapshot = { };
+	u8 regs[ISL_REG_MAX + 1];
+	struct rtc_time tm;
+	__le16 temp;
+	int err;
+
+	if (off >= sizeof(snapshot))
+		return 0;
+
+	err = isl12020_bus_read_path(priv, ISL12020_BUS_SNAPSHOT, ISL_REG_RTC_SC, regs,
+				     sizeof(regs));
+	if (err)
+		return err;
+
+	/* the read may have cleared flags, they must not get lost */
+	isl12020_handle_sr(priv, regs[ISL_REG_CSR_SR]);
+
+	isl12020_regs_to_tm(regs, &tm);
+	memcpy(&temp, &regs[ISL_REG_TEMP_TKOL], sizeof(temp));
+
+	snapshot.version = cpu_to_le16(SNAPSHOT_VERSION);
+	snapshot.size = cpu_to_le16(sizeof(snapshot));
+	snapshot.time = cpu_to_le64(rtc_tm_to_time64(&tm));
+	snapshot.sr = regs[ISL_REG_CSR_SR];
+	snapshot.int_ctrl = regs[ISL_REG_CSR_INT];
+	snapshot.pwrvdd = regs[ISL_REG_CSR_PWRVDD];
+	snapshot.pwrbat = regs[ISL_REG_CSR_PWRBAT];
+	snapshot.beta = regs[ISL_REG_CSR_BETA];
+	snapshot.temperature = cpu_to_le32(isl12020_temp_from_raw(temp));
+
+	count = min_t(size_t, count, sizeof(snapshot) - off);
+	memcpy(buf, (u8 *)&snapshot + off, count);
+
+	return count;
+}
+
+/* time, status, config and temperature in one pread() */
+static const struct bin_attribute isl12020_snapshot_bin_attr = {
+	.attr = {
+		.name = "snapshot",
+		.mode = 0444,
+	},
+	.size = sizeof(struct isl12020_snapshot),
+	.read = isl12020_snapshot_read,
+};
+
+static bool isl12020_regmap_writeable_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case ISL_REG_RTC_SC ... ISL_REG_CSR_BETA:
+	case ISL_REG_ALARM_SCA0 ... ISL_REG_ALARM_DWA0:
+	case ISL_REG_DSTCR_DSTMOFD ... ISL_REG_DSTCR_DSTHRRV:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* everything the chip updates on its own must bypass the register cache */
+static bool isl12020_regmap_volatile_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case ISL_REG_RTC_SC ... ISL_REG_CSR_SR:
+	case ISL_REG_CSR_FATR:
+	case ISL_REG_CSR_FDTR:
+	case ISL_REG_TSV2B_VSC ... ISL_REG_TSB2V_BMO:
+	case ISL_REG_TEMP_TKOL:
+	case ISL_REG_TEMP_TKOM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* status bits may be cleared by reading SR, so never read it behind our back */
+static bool isl12020_regmap_precious_reg(struct device *dev, unsigned int reg)
+{
+	return reg == ISL_REG_CSR_SR;
+}
+
+static const struct regmap_config isl12020_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.use_single_write = true,
+	.max_register = ISL_REG_MAX,
+	.writeable_reg = isl12020_regmap_writeable_reg,
+	.volatile_reg = isl12020_regmap_volatile_reg,
+	.precious_reg = isl12020_regmap_precious_reg,
+	.cache_type = REGCACHE_MAPLE,
+};
+
+/* decode the time and control/status block read at probe time */
+static void isl12020_init_state(struct isl12020_data *priv, const u8 *regs)
+{
+	u8 sr = regs[ISL_REG_CSR_SR];
+
+	if (sr & ISL_BIT_CSR_SR_OSCF)
+		dev_warn(&priv->client->dev, "oscillator failure detected\n");
+	if (sr & ISL_BIT_CSR_SR_RTCF)
+		dev_warn(&priv->client->dev, "RTC power failure detected\n");
+
+	/* ISL_BIT_CSR_INT_FOBATB flag is a reversed bit */
+	priv->config.freq_out_mode = regs[ISL_REG_CSR_INT] & MASK4BITS;
+	priv->config.freq_out_bat = !(regs[ISL_REG_CSR_INT] & ISL_BIT_CSR_INT_FOBATB);
+	priv->config.tse = !!(regs[ISL_REG_CSR_BETA] & ISL_BIT_CSR_BETA_TSE);
+	priv->config.btse = !!(regs[ISL_REG_CSR_BETA] & ISL_BIT_CSR_BETA_BTSE);
+	priv->config.btsr = !!(regs[ISL_REG_CSR_BETA] & ISL_BIT_CSR_BETA_BTSR);
+
+	isl12020_sr_to_status(sr, priv->config.tse, &priv->status);
+
+	/* flags found at probe time happened while the system was down */
+	mutex_lock(&priv->lock);
+	isl12020_log_events(priv, &(struct isl12020_status){ }, &priv->status);
+	mutex_unlock(&priv->lock);
+}
+
+/*
+ * hwmon and the temperature sensor config are not needed to read the time, they run after the
+ * rtc device is registered, the frequency output and the providers others may wait for do not
+ */
+static void isl12020_setup_work(struct work_struct *work)
+{
+	struct isl12020_data *priv = container_of(work, struct isl12020_data, setup_work);
+	struct device *dev = &priv->client->dev;
+	bool changed;
+	bool btse;
+	bool btsr;
+	bool tse;
+	int err;
+
+	/* setup of hwmon failing is not critical */
+	priv->hwmon_dev = hwmon_device_register_with_info(dev, INTERNAL_NAME, priv,
+							  &isl12020_chip_info, NULL);
+	if (IS_ERR(priv->hwmon_dev)) {
+		dev_warn(dev, "registering hwmon device failed (%ld)\n", PTR_ERR(priv->hwmon_dev));
+	}
+
+	/* collect all properties first, so the config register is written once at most */
+	mutex_lock(&priv->lock);
+	tse = priv->config.tse || device_property_present(dev, "temperature-sensor-enable");
+	btse = priv->config.btse || device_property_present(dev,
+							    "battery-temperature-sensor-enable");
+	btsr = priv->config.btsr || device_property_present(dev, "high-sensing-frequency-enable");
+	err = isl12020_set_beta(priv, tse, btse, btsr, &changed);
+	mutex_unlock(&priv->lock);
+	if (err)
+		dev_warn(dev, "enabling the temperature sensors failed (%d)\n", err);
+	dev_dbg(dev, "deferred config applied with %u transfers\n", !err && changed);
+}
+
+/*
+ * the frequency output is applied before the clock provider and the sysfs files exist, neither
+ * a clock consumer nor a calibration can see the output switch behind their backs
+ */
+static void isl12020_init_freq_out(struct isl12020_data *priv)
+{
+	struct device *dev = &priv->client->dev;
+	u32 freq_out_mode = 0;
+	bool freq_out_bat;
+	int err;
+
+	/*
+	 * failure of setting the frequency output support is not critical
+	 * set frequency output to disabled in battery and normal mode by default
+	 * which enables alarm signal support (an internal hardware switch)
+	 */
+	freq_out_bat = device_property_present(dev, "battery-frequency-output-enable");
+	device_property_read_u32(dev, "frequency-output-mode", &freq_out_mode);
+	rtc_lock(priv->rtc);
+	err = isl12020_apply_freq_out(priv, freq_out_mode, freq_out_bat, NULL);
+	rtc_unlock(priv->rtc);
+	if (err) {
+		dev_warn(dev,
+			 "setting frequency output failed (battery mode=%d, mode=%d, err=%d)\n",
+			 freq_out_bat, freq_out_mode, err);
+	}
+}
+
+static int isl12020_probe(struct i2c_client *client)
+{
+	struct nvmem_config nvmem_config = {
+		.name = "isl12020_sram",
+		.id = NVMEM_DEVID_AUTO,
+		.type = NVMEM_TYPE_BATTERY_BACKED,
+		.word_size = 1,
+		.stride = 1,
+		.size = ISL_USR_LEN,
+		.reg_read = isl12020_nvmem_read,
+		.reg_write = isl12020_nvmem_write,
+	};
+	struct regmap_config *regmap_config;
+	struct isl12020_data *priv;
+	const char *debugfs_name;
+	u8 *regs;
+	int err;
+
+	priv = devm_kzalloc(&client->dev, sizeof(struct isl12020_data), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	/* plain i2c keeps every bulk access in one transfer, smbus block mostly does too */
+	if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
+		priv->bus_mode = ISL12020_BUS_MODE_I2C;
+	else if (i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_I2C_BLOCK))
+		priv->bus_mode = ISL12020_BUS_MODE_BLOCK;
+	else if (i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_BYTE_DATA))
+		priv->bus_mode = ISL12020_BUS_MODE_BYTE;
+	else
+		return -ENODEV;
+	if (priv->bus_mode != ISL12020_BUS_MODE_I2C)
+		dev_info(&client->dev, "no plain i2c support, using %s transfers\n",
+			 bus_mode_names[priv->bus_mode]);
+
+	priv->client = client;
+	dev_set_drvdata(&client->dev, priv);
+	nvmem_config.priv = priv;
+
+	mutex_init(&priv->lock);
+	seqcount_mutex_init(&priv->seq, &priv->lock);
+	spin_lock_init(&priv->time_cache.lock);
+	spin_lock_init(&priv->bus_stats.lock);
+	spin_lock_init(&priv->calib.lock);
+	spin_lock_init(&priv->pps.lock);
+	priv->bus_stats.probing = true;
+	device_property_read_u32(&client->dev, "time-cache-interval", &priv->time_cache.interval);
+
+	regs = devm_kzalloc(&client->dev, ISL_REG_INIT_LEN, GFP_KERNEL);
+	regmap_config = devm_kmemdup(&client->dev, &isl12020_regmap_config,
+				     sizeof(isl12020_regmap_config), GFP_KERNEL);
+	if (!regs || !regmap_config)
+		return -ENOMEM;
+
+	/*
+	 * get initial state of the rtc in one transfer, this is critical, the register cache is
+	 * seeded from it instead of reading every config register on first use
+	 */
+	err = isl12020_bus_read(priv, ISL_REG_RTC_SC, regs, ISL_REG_INIT_LEN);
+	if (err) {
+		dev_err(&client->dev, "failed to acquire initial status (%d)\n", err);
+		return err;
+	}
+	isl12020_init_state(priv, regs);
+
+	regmap_config->reg_defaults_raw = regs;
+	regmap_config->num_reg_defaults_raw = ISL_REG_INIT_LEN;
+
+	priv->regmap = devm_regmap_init(&client->dev, &isl12020_regmap_bus, priv, regmap_config);
+	if (IS_ERR(priv->regmap)) {
+		err = PTR_ERR(priv->regmap);
+		dev_err(&client->dev, "allocating regmap failed (%d)\n", err);
+		return err;
+	}
+
+	priv->rtc = devm_rtc_allocate_device(&client->dev);
+	if (IS_ERR(priv->rtc)) {
+		err = PTR_ERR(priv->rtc);
+		dev_err(&client->dev, "allocating rtc device failed (%d)\n", err);
+		return err;
+	}
+
+	/* the works use the regmap and the rtc, so they have to be cancelled before both go */
+	err = devm_delayed_work_autocancel(&client->dev, &priv->status_work,
+					   isl12020_status_work);
+	if (err)
+		return err;
+	err = devm_work_autocancel(&client->dev, &priv->calib_work, isl12020_calib_work);
+	if (err)
+		return err;
+	err = devm_work_autocancel(&client->dev, &priv->setup_work, isl12020_setup_work);
+	if (err)
+		return err;
+
+	priv->rtc->ops = &isl12020_rtc_ops;
+	priv->rtc->range_min = RTC_TIMESTAMP_BEGIN_2000;
+	priv->rtc->range_max = RTC_TIMESTAMP_END_2099;
+	set_bit(RTC_FEATURE_CORRECTION, priv->rtc->features);
+	set_bit(RTC_FEATURE_BACKUP_SWITCH_MODE, priv->rtc->features);
+
+	/*
+	 * alarms need the IRQ/F_OUT line, either as interrupt or as "wakeup-source" wired to
+	 * something like a PMIC, the i2c core takes care of the wakeup setup of the latter,
+	 * 1 Hz update interrupts require the interrupt to be configured as edge triggered
+	 */
+	if (client->irq > 0) {
+		/* the line may carry the wave-gen output, enabled only for alarms or 1 Hz edges */
+		priv->irq_masked = true;
+		err = devm_request_threaded_irq(&client->dev, client->irq, isl12020_irq,
+						isl12020_irq_handler,
+						IRQF_ONESHOT | IRQF_NO_AUTOEN, DRIVER_NAME, priv);
+		if (err) {
+			dev_warn(&client->dev, "requesting irq %d failed (%d)\n", client->irq, err);
+			client->irq = 0;
+			priv->irq_masked = false;
+		} else {
+			device_init_wakeup(&client->dev, true);
+			priv->irq_level = irq_get_trigger_type(client->irq) &
+					  IRQ_TYPE_LEVEL_MASK;
+			if (priv->irq_level)
+				dev_info(&client->dev, "level irq, no update interrupts\n");
+			isl12020_mask_irq(priv, false);
+		}
+	}
+	if (client->irq <= 0 && !device_property_read_bool(&client->dev, "wakeup-source"))
+		clear_bit(RTC_FEATURE_ALARM, priv->rtc->features);
+	isl12020_init_freq_out(priv);
+
+	/* sysfs is required and should not fail */
+	err = sysfs_create_files(&client->dev.kobj, isl12020_attrs);
+	if (err) {
+		pr_err("failed to create sysfs entries (%d)\n", err);
+		goto sysfs_fail;
+	}
+	err = sysfs_create_bin_file(&client->dev.kobj, &isl12020_snapshot_bin_attr);
+	if (err) {
+		pr_err("failed to create sysfs snapshot entry (%d)\n", err);
+		goto sysfs_bin_fail;
+	}
+
+	/* debugfs is optional, failures are ignored */
+	debugfs_name = devm_kasprintf(&client->dev, GFP_KERNEL, "%s-%s", DRIVER_NAME,
+				      dev_name(&client->dev));
+	if (debugfs_name) {
+		priv->debugfs = debugfs_create_dir(debugfs_name, NULL);
+		debugfs_create_file("bus_stats", 0444, priv->debugfs, priv,
+				    &isl12020_debugfs_bus_fops);
+		debugfs_create_file("power_switch", 0444, priv->debugfs, priv,
+				    &isl12020_debugfs_power_switch_fops);
+		debugfs_create_file("events", 0444, priv->debugfs, priv,
+				    &isl12020_debugfs_events_fops);
+		devm_add_action_or_reset(&client->dev, isl12020_debugfs_remove, priv->debugfs);
+	}
+	priv->bus_stats.probing = false;
+
+	/* consumers deferring on the clock or the pps source must see them before probe returns */
+	err = isl12020_clk_init(priv);
+	if (err)
+		dev_warn(&client->dev, "registering clock provider failed (%d)\n", err);
+	err = isl12020_pps_init(priv);
+	if (err)
+		dev_warn(&client->dev, "registering pps source failed (%d)\n", err);
+	if (priv->pps.dev && priv->debugfs)
+		debugfs_create_file("pps", 0444, priv->debugfs, priv, &isl12020_debugfs_pps_fops);
+
+	schedule_delayed_work(&priv->status_work, msecs_to_jiffies(STATUS_POLL_INTERVAL));
+
+	/* the time is readable from here on, the rest of the config follows in the background */
+	err = devm_rtc_register_device(priv->rtc);
+	if (err)
+		return err;
+	schedule_work(&priv->setup_work);
+
+	/* the user sram is accessed in as few transfers as the adapter allows, not critical */
+	err = devm_rtc_nvmem_register(priv->rtc, &nvmem_config);
+	if (err)
+		dev_warn(&client->dev, "registering nvmem failed (%d)\n", err);
+
+	return 0;
+
+sysfs_bin_fail:
+	sysfs_remove_files(&client->dev.kobj, isl12020_attrs);
+sysfs_fail:
+	return err;
+}
+
+/*
+ * after a total power loss the chip comes up with its defaults, the register cache still
+ * holds the config, so every writeable block goes back in one transfer
+ */
+static int isl12020_restore_regs(struct isl12020_data *priv)
+{
+	static const u8 blocks[][2] = {
+		{ ISL_REG_CSR_INT, ISL_REG_CSR_BETA },
+		{ ISL_REG_ALARM_SCA0, ISL_REG_ALARM_DWA0 },
+		{ ISL_REG_DSTCR_DSTMOFD, ISL_REG_DSTCR_DSTHRRV },
+	};
+	u8 buf[ISL_REG_DSTCR_DSTHRRV - ISL_REG_DSTCR_DSTMOFD + 2];
+	size_t len;
+	int err;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blocks); i++) {
+		len = blocks[i][1] - blocks[i][0] + 1;
+		buf[0] = blocks[i][0];
+		err = regmap_bulk_read(priv->regmap, blocks[i][0], &buf[1], len);
+		if (!err)
+			err = isl12020_bus_write(priv, buf, len + 1);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int isl12020_suspend(struct device *dev)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	int irq = priv->client->irq;
+	int err = 0;
+
+	cancel_delayed_work_sync(&priv->status_work);
+
+	rtc_lock(priv->rtc);
+	/* the edges can not be measured across a suspend */
+	if (READ_ONCE(priv->calib.state) == ISL12020_CALIB_RUNNING) {
+		spin_lock_irq(&priv->calib.lock);
+		priv->calib.state = ISL12020_CALIB_FAILED;
+		spin_unlock_irq(&priv->calib.lock);
+		isl12020_calib_restore(priv, priv->calib.freq_out_mode);
+		sysfs_notify(&dev->kobj, NULL, "calibration");
+	}
+
+	/* waking up every second is pointless, an enabled alarm moves to the alarm registers */
+	priv->pm_freq_out_mode = priv->config.freq_out_mode;
+	if (isl12020_uie_mode(priv) && priv->alarm.enabled && device_may_wakeup(dev)) {
+		err = isl12020_apply_freq_out(priv, 0, priv->config.freq_out_bat, NULL);
+		if (err)
+			dev_warn(dev, "moving alarm to the alarm registers failed (%d)\n", err);
+	}
+	rtc_unlock(priv->rtc);
+
+	if (irq > 0) {
+		if (device_may_wakeup(dev) && priv->alarm.enabled && !isl12020_uie_mode(priv))
+			priv->irq_wake = !enable_irq_wake(irq);
+		if (!priv->irq_wake) {
+			disable_irq(irq);
+			priv->irq_disabled = true;
+		}
+	}
+
+	/* a separate pps line is never a wakeup source, its edges have no use while suspended */
+	if (priv->pps.irq > 0)
+		disable_irq(priv->pps.irq);
+
+	return 0;
+}
+
+/* only SR and the time can change while suspended, the config is kept by the battery */
+static int isl12020_resume(struct device *dev)
+{
+	struct isl12020_data *priv = dev_get_drvdata(dev);
+	int irq = priv->client->irq;
+	unsigned int sr;
+	int err;
+
+	if (priv->irq_wake) {
+		disable_irq_wake(irq);
+		priv->irq_wake = false;
+	}
+	if (priv->irq_disabled) {
+		enable_irq(irq);
+		priv->irq_disabled = false;
+	}
+	if (priv->pps.irq > 0)
+		enable_irq(priv->pps.irq);
+
+	/* monotonic clock and jiffies stood still, everything extrapolated from them is stale */
+	isl12020_time_cache_invalidate(priv);
+	mutex_lock(&priv->lock);
+	priv->temp_cache.valid = false;
+	mutex_unlock(&priv->lock);
+
+	err = regmap_read(priv->regmap, ISL_REG_CSR_SR, &sr);
+	if (!err) {
+		if (sr & ISL_BIT_CSR_SR_RTCF) {
+			err = isl12020_restore_regs(priv);
+			if (err)
+				dev_warn(dev, "restoring registers failed (%d)\n", err);
+		}
+		isl12020_handle_sr(priv, sr);
+	} else {
+		dev_warn(dev, "reading status register failed (%d)\n", err);
+	}
+
+	if (priv->pm_freq_out_mode != priv->config.freq_out_mode) {
+		err = isl12020_change_freq_out(priv, priv->pm_freq_out_mode);
+		if (err)
+			dev_warn(dev, "restoring frequency output failed (%d)\n", err);
+	}
+
+	schedule_delayed_work(&priv->status_work, msecs_to_jiffies(STATUS_POLL_INTERVAL));
+
+	return 0;
+}
+
+static DEFINE_SIMPLE_DEV_PM_OPS(isl12020_pm_ops, isl12020_suspend, isl12020_resume);
+
 static void isl12020_remove(struct i2c_client *client)
 {
 	struct isl12020_data *priv = i2c_get_clientdata(client);
 
+	/* the setup work registers hwmon and must not race with its removal */
+	cancel_work_sync(&priv->setup_work);
+	sysfs_remove_bin_file(&client->dev.kobj, &isl12020_snapshot_bin_attr);
 	sysfs_remove_files(&client->dev.kobj, isl12020_attrs);
-	hwmon_device_unregister(priv->hwmon_dev);
+	if (!IS_ERR_OR_NULL(priv->hwmon_dev))
+		hwmon_device_unregister(priv->hwmon_dev);
 }
 
 static const struct of_device_id isl12020_of_match_table[] = {
@@ -652,6 +2931,8 @@ static struct i2c_driver isl12020_driver = {
 	.driver	= {
 		.name = DRIVER_NAME,
 		.of_match_table = isl12020_of_match_table,
+		.pm = pm_sleep_ptr(&isl12020_pm_ops),
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = isl12020_probe,
 	.remove = isl12020_remove,
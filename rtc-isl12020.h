@@ -0,0 +1,322 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * rtc-isl12020 - Renesas ISL12020M RTC I2C driver internals, shared with the kunit tests
+ * Copyright (C) 2023 Wilken Gottwalt <wilken.gottwalt@posteo.net>
+ */
+
+#ifndef _RTC_ISL12020_H
+#define _RTC_ISL12020_H
+
+#include <linux/bits.h>
+#include <linux/clk-provider.h>
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/regmap.h>
+#include <linux/rtc.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+#define INTERNAL_NAME		"isl12020"
+#define DRIVER_NAME		"rtc-" INTERNAL_NAME
+
+#define MASK3BITS		GENMASK(2, 0)
+#define MASK4BITS		GENMASK(3, 0)
+#define MASK5BITS		GENMASK(4, 0)
+#define MASK6BITS		GENMASK(5, 0)
+#define MASK7BITS		GENMASK(6, 0)
+
+#define CENTURY_LEN		100
+#define MONTH_OFFSET		1
+
+#define MILLI_DEGREE_CELCIUS	1000
+#define CELCIUS0		(369 * MILLI_DEGREE_CELCIUS)
+#define CELCIUS0_M		(273 * MILLI_DEGREE_CELCIUS)
+#define TEMP_MIN		(-20 * MILLI_DEGREE_CELCIUS)
+#define TEMP_MIN_M		(-40 * MILLI_DEGREE_CELCIUS)
+#define TEMP_LCRIT		(-40 * MILLI_DEGREE_CELCIUS)
+#define TEMP_LCRIT_M		(-50 * MILLI_DEGREE_CELCIUS)
+#define TEMP_MAX		(75 * MILLI_DEGREE_CELCIUS)
+#define TEMP_MAX_M		(85 * MILLI_DEGREE_CELCIUS)
+#define TEMP_CRIT		(85 * MILLI_DEGREE_CELCIUS)
+#define TEMP_CRIT_M		(90 * MILLI_DEGREE_CELCIUS)
+#define TEMP_PERIOD		(10 * 60 * MSEC_PER_SEC) /* sensing period in ms */
+#define TEMP_PERIOD_HIGH_FREQ	(60 * MSEC_PER_SEC) /* sensing period with BTSR set in ms */
+
+#define FREQ_OUT_MODE_MAX	GENMASK(3, 0)
+#define FREQ_OUT_MODE_1HZ	10
+
+/*
+ * ITRO trimming: IATR pulls the crystal in ~1 ppm steps, 32 being the
+ * nominal frequency and larger values slowing the clock down, IDTR adds a
+ * coarse digital step of +-30.5 ppm on top of it.
+ */
+#define TRIM_IATR_NOMINAL	32
+#define TRIM_IATR_STEP_PPB	1000
+#define TRIM_IDTR_STEP_PPB	30500
+
+/* calibration window in 1 Hz periods, the first edges after switching the output are skipped */
+#define CALIB_SETTLE_EDGES	2
+#define CALIB_WINDOW_MIN	10
+#define CALIB_WINDOW_MAX	86400
+
+#define SNAPSHOT_VERSION	1
+
+#define STATUS_POLL_INTERVAL	(60 * MSEC_PER_SEC) /* the chip only signals alarms */
+#define STATUS_EVENTS		32 /* power and oscillator failures kept for post-mortem */
+
+#define BUS_RETRIES		3 /* retries after a lost arbitration on a shared bus */
+#define BUS_HIST_BUCKETS	16
+
+/* ISL12020M register offsets */
+#define ISL_REG_RTC_SC		0x00 /* bit 0-6 = seconds 0-59, default 0x00 */
+#define ISL_REG_RTC_MN		0x01 /* bit 0-6 = minutes 0-59, default 0x00 */
+#define ISL_REG_RTC_HR		0x02 /* bit 0-5 = hours 0-23, bit 7 = 24 hour time, default 0x00 */
+#define ISL_REG_RTC_DT		0x03 /* bit 0-5 = days 1-31, default 0x01 */
+#define ISL_REG_RTC_MO		0x04 /* bit 0-4 = months 1-12, default 0x01 */
+#define ISL_REG_RTC_YR		0x05 /* bit 0-7 = years 0-99, default 0x00 */
+#define ISL_REG_RTC_DW		0x06 /* bit 0-2 = day of week 0-6, default 0x00 */
+
+#define ISL_REG_CSR_SR		0x07
+#define ISL_REG_CSR_INT		0x08
+#define ISL_REG_CSR_PWRVDD	0x09
+#define ISL_REG_CSR_PWRBAT	0x0A
+#define ISL_REG_CSR_ITRO	0x0B
+#define ISL_REG_CSR_ALPHA	0x0C
+#define ISL_REG_CSR_BETA	0x0D
+#define ISL_REG_CSR_FATR	0x0E /* read only, final analog trimming */
+#define ISL_REG_CSR_FDTR	0x0F /* read only, final digital trimming */
+
+#define ISL_REG_ALARM_SCA0	0x10 /* bit 0-6 = seconds 0-59, bit 7 = enable */
+#define ISL_REG_ALARM_MNA0	0x11 /* bit 0-6 = minutes 0-59, bit 7 = enable */
+#define ISL_REG_ALARM_HRA0	0x12 /* bit 0-5 = hours 0-23, bit 7 = enable */
+#define ISL_REG_ALARM_DTA0	0x13 /* bit 0-5 = days 1-31, bit 7 = enable */
+#define ISL_REG_ALARM_MOA0	0x14 /* bit 0-4 = months 1-12, bit 7 = enable */
+#define ISL_REG_ALARM_DWA0	0x15 /* bit 0-2 = day of week 0-6, bit 7 = enable */
+
+#define ISL_REG_TSV2B_VSC	0x16 /* read only, VDD to battery time stamp, seconds */
+#define ISL_REG_TSV2B_VMN	0x17 /* read only, VDD to battery time stamp, minutes */
+#define ISL_REG_TSV2B_VHR	0x18 /* read only, VDD to battery time stamp, hours */
+#define ISL_REG_TSV2B_VDT	0x19 /* read only, VDD to battery time stamp, days */
+#define ISL_REG_TSV2B_VMO	0x1A /* read only, VDD to battery time stamp, months */
+#define ISL_REG_TSB2V_BSC	0x1B /* read only, battery to VDD time stamp, seconds */
+#define ISL_REG_TSB2V_BMO	0x1F /* read only, battery to VDD time stamp, months */
+
+#define ISL_REG_DSTCR_DSTMOFD	0x20
+#define ISL_REG_DSTCR_DSTHRRV	0x27
+
+#define ISL_REG_TEMP_TKOL	0x28 /* bit 0-7 = lower part of 10bit temperature */
+#define ISL_REG_TEMP_TKOM	0x29 /* bit 0-1 = upper part of 10bit temperature */
+
+#define ISL_REG_USR_START	0x80 /* battery backed user sram, not handled by the regmap */
+#define ISL_REG_USR_END		0xFF
+#define ISL_USR_LEN		(ISL_REG_USR_END - ISL_REG_USR_START + 1)
+
+#define ISL_REG_MAX		ISL_REG_TEMP_TKOM
+#define ISL_REG_INIT_LEN	(ISL_REG_CSR_BETA + 1) /* time and control/status block */
+
+/* ISL12020M bits  */
+#define ISL_BIT_RTC_HR_MIL	BIT(7)
+
+#define ISL_BIT_CSR_SR_OSCF	BIT(7)
+#define ISL_BIT_CSR_SR_ALM	BIT(4)
+#define ISL_BIT_CSR_SR_LVDD	BIT(3)
+#define ISL_BIT_CSR_SR_LBAT85	BIT(2)
+#define ISL_BIT_CSR_SR_LBAT75	BIT(1)
+#define ISL_BIT_CSR_SR_RTCF	BIT(0)
+#define ISL_BIT_CSR_INT_WRTC	BIT(6)
+#define ISL_BIT_CSR_INT_FOBATB	BIT(4)
+#define ISL_MASK_CSR_PWRVDD_TRIP	GENMASK(2, 0)
+#define ISL_BIT_CSR_PWRBAT_RESEALB	BIT(6)
+#define ISL_MASK_CSR_PWRBAT_VB85	GENMASK(5, 3)
+#define ISL_MASK_CSR_PWRBAT_VB75	GENMASK(2, 0)
+#define ISL_MASK_CSR_ITRO_IDTR	GENMASK(7, 6)
+#define ISL_MASK_CSR_ITRO_IATR	GENMASK(5, 0)
+#define ISL_BIT_CSR_BETA_TSE	BIT(7)
+#define ISL_BIT_CSR_BETA_BTSE	BIT(6)
+#define ISL_BIT_CSR_BETA_BTSR	BIT(5)
+#define ISL_BIT_ALARM_EN	BIT(7)
+
+/* the cheapest transfer type the adapter supports, chosen at probe time */
+enum isl12020_bus_mode {
+	ISL12020_BUS_MODE_I2C,
+	ISL12020_BUS_MODE_BLOCK,
+	ISL12020_BUS_MODE_BYTE,
+};
+
+/* bus accesses are accounted by the register range they target */
+enum isl12020_bus_path {
+	ISL12020_BUS_PROBE,
+	ISL12020_BUS_READ_TIME,
+	ISL12020_BUS_SET_TIME,
+	ISL12020_BUS_TEMP,
+	ISL12020_BUS_CONFIG,
+	ISL12020_BUS_ALARM,
+	ISL12020_BUS_NVMEM,
+	ISL12020_BUS_SNAPSHOT,		/* sysfs snapshot, the whole register file */
+	ISL12020_BUS_PATHS,
+};
+
+struct isl12020_bus_counters {
+	u64 transfers;
+	u64 bytes;
+	u64 errors;
+	u64 retries;
+};
+
+struct isl12020_bus_stats {
+	spinlock_t lock;
+	bool probing;
+	struct isl12020_bus_counters path[ISL12020_BUS_PATHS];
+	u64 latency[BUS_HIST_BUCKETS];	/* log2 buckets of the transfer time in us */
+};
+
+/* binary sysfs snapshot, all fields little endian, new fields are only appended */
+struct isl12020_snapshot {
+	__le16 version;
+	__le16 size;			/* size of this struct */
+	__le64 time;			/* rtc time in seconds since the epoch */
+	u8 sr;
+	u8 int_ctrl;
+	u8 pwrvdd;
+	u8 pwrbat;
+	u8 beta;
+	u8 reserved[3];
+	__le32 temperature;		/* milli degree celcius, only valid with BETA TSE set */
+} __packed;
+
+enum isl12020_event_category {
+	ISL12020_EVENT_LVDD,
+	ISL12020_EVENT_LBAT85,
+	ISL12020_EVENT_LBAT75,
+	ISL12020_EVENT_OSCF,
+};
+
+struct isl12020_event {
+	time64_t time;			/* system time the failure was observed */
+	enum isl12020_event_category category;
+};
+
+struct isl12020_status {
+	bool oscf;			/* oscillator failure */
+	bool rtcf;			/* rtc failure due low voltage or oscillator failure */
+	bool power_triggers_checked;	/* checking lvdd and lbat* only after setting TSE */
+	bool lvdd;			/* low voltage on normal power line */
+	bool lbat85;			/* low voltage on battery first trigger */
+	bool lbat75;			/* low voltage on battery second trigger */
+};
+
+struct isl12020_config {
+	u8 freq_out_mode;
+	bool freq_out_bat;
+	bool tse;
+	bool btse;
+	bool btsr;
+};
+
+struct isl12020_time_cache {
+	spinlock_t lock;
+	bool valid;
+	time64_t secs;			/* rtc time of the anchor */
+	ktime_t stamp;			/* latest known point in time of the second edge of secs */
+	ktime_t validated;		/* time of the last bus read */
+	u32 interval;			/* revalidation interval in seconds, 0 = disabled */
+	u64 hits;
+	u64 bus_reads;
+};
+
+enum isl12020_calib_state {
+	ISL12020_CALIB_IDLE,
+	ISL12020_CALIB_RUNNING,
+	ISL12020_CALIB_DONE,
+	ISL12020_CALIB_FAILED,
+};
+
+struct isl12020_calib {
+	spinlock_t lock;		/* guards against the 1 Hz hard irq */
+	enum isl12020_calib_state state;
+	u32 window;			/* measurement window in 1 Hz periods */
+	u32 edges;			/* edges seen since the start, including settling */
+	ktime_t first;			/* first edge after settling */
+	ktime_t last;			/* edge closing the window */
+	long error;			/* measured frequency error in ppb, positive runs fast */
+	u8 freq_out_mode;		/* frequency output mode to restore afterwards */
+};
+
+struct isl12020_pps {
+	struct pps_device *dev;		/* NULL if no pps source is configured */
+	struct gpio_desc *gpio;		/* separate pps line, NULL if on the IRQ/F_OUT interrupt */
+	int irq;			/* interrupt of the separate pps line, 0 if none */
+	bool irq_masked;		/* irq masked while F_OUT is not at 1 Hz */
+	spinlock_t lock;		/* guards against the 1 Hz hard irq */
+	ktime_t last;
+	u64 edges;
+	u64 missed;
+	u64 jitter_last;		/* deviation of the period from 1 s in ns */
+	u64 jitter_avg;
+	u64 jitter_max;
+};
+
+struct isl12020_temp_cache {
+	bool valid;
+	long value;
+	unsigned long expires;		/* no new conversion can exist before, in jiffies */
+};
+
+struct isl12020_data {
+	struct i2c_client *client;
+	enum isl12020_bus_mode bus_mode;
+	struct rtc_device *rtc;
+	struct regmap *regmap;
+	struct device *hwmon_dev;
+	struct mutex lock;		/* serializes config and status writers */
+	seqcount_mutex_t seq;		/* lockless snapshots of config and status */
+	struct isl12020_status status;
+	struct isl12020_config config;
+	struct rtc_wkalrm alarm;	/* alarm kept in software while in 1 Hz update mode */
+	struct isl12020_time_cache time_cache;
+	struct isl12020_temp_cache temp_cache;
+	struct isl12020_calib calib;
+	struct work_struct calib_work;
+	struct isl12020_pps pps;
+	struct clk_hw clk_hw;
+	u8 clk_mode;			/* frequency output mode used while the clock is prepared */
+	u8 pm_freq_out_mode;		/* frequency output mode to restore on resume */
+	bool irq_level;			/* level triggered irq, no 1 Hz update interrupts */
+	bool irq_masked;		/* irq masked while F_OUT carries a clock */
+	bool irq_wake;			/* irq armed as wakeup source during suspend */
+	bool irq_disabled;		/* irq quiesced during suspend */
+	u32 set_time_latency;		/* averaged set_time() call to SC latch in ns */
+	struct isl12020_bus_stats bus_stats;
+	struct dentry *debugfs;
+	struct delayed_work status_work;
+	struct work_struct setup_work;
+	struct isl12020_event events[STATUS_EVENTS];	/* ring buffer, guarded by lock */
+	unsigned int events_head;
+	unsigned int events_count;
+};
+
+#if IS_ENABLED(CONFIG_KUNIT)
+extern const struct attribute *isl12020_attrs[];
+
+int isl12020_set_beta(struct isl12020_data *priv, bool tse, bool btse, bool btsr,
+		      bool *changed);
+long isl12020_trim_to_offset(unsigned int itro);
+int isl12020_get_trim(struct isl12020_data *priv, long *offset);
+int isl12020_set_trim(struct isl12020_data *priv, long offset);
+bool isl12020_time_cache_get(struct isl12020_data *priv, struct rtc_time *tm);
+void isl12020_time_cache_update(struct isl12020_data *priv, struct rtc_time *tm,
+				ktime_t before, ktime_t after);
+void isl12020_time_cache_edge(struct isl12020_data *priv, ktime_t edge);
+int isl12020_read_temp(struct isl12020_data *priv, long *val);
+bool isl12020_timestamp_to_tm(const u8 *regs, time64_t now, struct rtc_time *tm);
+int isl12020_rtc_ops_read_time(struct device *dev, struct rtc_time *tm);
+int isl12020_rtc_ops_set_time(struct device *dev, struct rtc_time *tm);
+int isl12020_nvmem_read(void *context, unsigned int offset, void *val, size_t bytes);
+int isl12020_nvmem_write(void *context, unsigned int offset, void *val, size_t bytes);
+#endif
+
+#endif /* _RTC_ISL12020_H */